@@ -13,7 +13,7 @@ def main() -> None:
 
     parser = argparse.ArgumentParser(
         description='python_bladerf is a Python wrapper for libbladerf. It also contains some additional tools.',
-        usage='python_bladerf [-h] {info, sweep} ...',
+        usage='python_bladerf [-h] {info, sweep, transfer} ...',
     )
     subparsers = parser.add_subparsers(dest='command', title='Available commands')
     subparsers.required = True
@@ -24,7 +24,7 @@ def main() -> None:
     pybladerf_info_parser.add_argument('-s', '--serial_numbers', action='store_true', help='show only founded serial_numbers')
 
     pybladerf_sweep_parser = subparsers.add_parser(
-        'sweep', help='a command-line spectrum analyzer.', usage='python_bladerf sweep [-h] [-d] [-f] [-g] [-w] [-c] [-1] [-N] [-o] [-p] [-B] [-S] [-s] [-b] [-r]',
+        'sweep', help='a command-line spectrum analyzer.', usage='python_bladerf sweep [-h] [-d] [-f] [-g] [-w] [-c] [-1] [-N] [-o] [-p] [-B] [-S] [-s] [-b] [-r] [-P] [-A] [-2]',
     )
 
     pybladerf_sweep_parser.add_argument('-d', action='store', help='serial number of desired BladeRF', metavar='', default='')
@@ -41,9 +41,12 @@ def main() -> None:
     pybladerf_sweep_parser.add_argument('-s', action='store', help='sample rate in MHz  (0.5 MHz - 122 MHz). Default is 61. To use a sample rate higher than 61, specify oversample', metavar='', default=61)
     pybladerf_sweep_parser.add_argument('-b', action='store', help='baseband filter bandwidth in MHz (0.2 MHz - 56 MHz). Default .75 * sample rate', metavar='')
     pybladerf_sweep_parser.add_argument('-r', action='store', help='<filename> output file', metavar='')
+    pybladerf_sweep_parser.add_argument('-A', action='store_true', help='calibrate the settle time of every hop instead of using pybladerf_sweep_await_time. If specified = Enable')
+    pybladerf_sweep_parser.add_argument('-2', action='store_true', help='capture every hop on both RX channels (RX_X2) and average their spectra, sample rate is limited to 30.72 MHz. If specified = Enable')
+    pybladerf_sweep_parser.add_argument('-P', action='store', help='policy when the buffer pool is exhausted ("B" - BLOCK, "N" - DROP NEWEST, "O" - DROP OLDEST). Default is BLOCK', metavar='', default='B', choices=['B', 'N', 'O'])
 
     pybladerf_transfer_parser = subparsers.add_parser(
-        'transfer', help='Send and receive signals using BladeRF. Input/output files consist of complex64 quadrature samples.', usage='python_bladerf transfer [-h] [-d] [-r] [-t] [-f] [-p] [-c] [-g] [-N] [-R] [-s] -[b] [-H] -[o]',
+        'transfer', help='Send and receive signals using BladeRF. Input/output files consist of complex64 quadrature samples.', usage='python_bladerf transfer [-h] [-d] [-r] [-t] [-f] [-p] [-c] [-g] [-N] [-R] [-s] [-b] [-H] [-o] [-F] [-C] [-M] [-X] [-G] [-A]',
     )
     pybladerf_transfer_parser.add_argument('-d', action='store', help='serial number of desired BladeRF', metavar='')
     pybladerf_transfer_parser.add_argument('-r', action='store', help='<filename> receive data into file (use "-" for stdout)', metavar='')
@@ -58,6 +61,12 @@ def main() -> None:
     pybladerf_transfer_parser.add_argument('-b', action='store', help='baseband filter bandwidth in MHz (0.2 MHz - 56 MHz). Default .75 * sample rate', metavar='')
     pybladerf_transfer_parser.add_argument('-H', action='store_true', help='synchronize RX/TX to external trigger input')
     pybladerf_transfer_parser.add_argument('-o', action='store_true', help='oversample. If specified = Enable')
+    pybladerf_transfer_parser.add_argument('-F', action='store_true', help='raw file format: native SC16_Q11 (SC8_Q7 with oversample) samples instead of complex64. RX also writes a <filename>.json header')
+    pybladerf_transfer_parser.add_argument('-C', action='store', help='compressed raw RX file ("B" - block floating point, "L" - lossless). Implies -F', metavar='', choices=['B', 'L'])
+    pybladerf_transfer_parser.add_argument('-M', action='store', help='mantissa bits of block floating point compression (2 - 16). Default is 8', metavar='', default=8)
+    pybladerf_transfer_parser.add_argument('-X', action='store', help='TX frequency in Hz when both -r and -t are given (full duplex). Default is the RX frequency', metavar='')
+    pybladerf_transfer_parser.add_argument('-G', action='store', help='TX gain when both -r and -t are given (full duplex). Default is the RX gain', metavar='')
+    pybladerf_transfer_parser.add_argument('-A', action='store_true', help='full duplex: start RX and TX at the same instant, to within the measured RX/TX clock offset (see the raw header)')
 
     if len(sys.argv) == 1:
         parser.print_help()
@@ -94,7 +103,14 @@ def main() -> None:
                                         one_shot=args.__dict__.get('1'),  # type: ignore
                                         num_sweeps=int(args.N) if args.N is not None else None,
                                         filename=args.r,
-                                        print_to_console=True)
+                                        print_to_console=True,
+                                        calibrate_settle=args.A,
+                                        dual_channel=args.__dict__.get('2'),  # type: ignore
+                                        drop_policy={
+                                            'B': pybladerf.pybladerf_sweep_drop_policy.PYBLADERF_SWEEP_DROP_POLICY_BLOCK,
+                                            'N': pybladerf.pybladerf_sweep_drop_policy.PYBLADERF_SWEEP_DROP_POLICY_DROP_NEWEST,
+                                            'O': pybladerf.pybladerf_sweep_drop_policy.PYBLADERF_SWEEP_DROP_POLICY_DROP_OLDEST,
+                                        }.get(args.P, pybladerf.pybladerf_sweep_drop_policy.PYBLADERF_SWEEP_DROP_POLICY_BLOCK))
 
     elif args.command == 'transfer':
         pybladerf_transfer.pybladerf_transfer(
@@ -112,6 +128,15 @@ def main() -> None:
             rx_filename=args.r,
             tx_filename=args.t,
             print_to_console=True,
+            raw_format=args.F,
+            compression={
+                'B': pybladerf.pybladerf_iq_codec.PYBLADERF_IQ_CODEC_BFP,
+                'L': pybladerf.pybladerf_iq_codec.PYBLADERF_IQ_CODEC_LOSSLESS,
+            }.get(args.C) if args.C is not None else None,  # type: ignore
+            compression_bits=int(args.M),
+            tx_frequency=int(args.X) if args.X is not None else None,
+            tx_gain=int(args.G) if args.G is not None else None,
+            align_start=args.A,
         )
 
 
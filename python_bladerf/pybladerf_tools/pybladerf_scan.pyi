@@ -4,7 +4,14 @@ def stop_all() -> None:
 def stop_sdr(serialno: str) -> None:
     ...
 
-def pybladerf_scan(frequencies: list[int], samples_per_scan: int, queue: object, sample_rate: int = 61_000_000, baseband_filter_bandwidth: int | None = None,
+def pybladerf_scan(frequencies: list[int], samples_per_scan: int | list[int], queue: object, sample_rate: int = 61_000_000, baseband_filter_bandwidth: int | None = None,
                    gain: int = 20, channel: int = 0, oversample: bool = False, antenna_enable: bool = False, serial_number: str | None = None,
-                   print_to_console: bool = True) -> None:
+                   print_to_console: bool = True, calibrate_settle: bool = False, weights: list[int] | None = None) -> None:
+    '''
+    `samples_per_scan` and `weights` take one value per frequency range. A range with weight 10 is revisited 10 times per scan,
+    evenly spread between the other hops, so its revisit latency drops without scanning everything faster.
+
+    With `calibrate_settle` the dead time after every retune is measured per hop (see utils.calibrate_settle_times) instead of using
+    `pybladerf_scan_await_time` for all of them. The result is kept in the quick tune cache, so later runs with the same plan skip the measurement.
+    '''
     ...
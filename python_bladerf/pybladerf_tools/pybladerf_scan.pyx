@@ -26,6 +26,7 @@
 from python_bladerf.pylibbladerf cimport pybladerf as c_pybladerf
 from libc.stdint cimport uint64_t, uint32_t, uint16_t, uint8_t
 from python_bladerf.pylibbladerf cimport cbladerf
+from python_bladerf.pybladerf_tools.utils import calibrate_settle_times, expand_frequency_plan, load_quick_tunes, load_settle_times, store_settle_times
 from python_bladerf import pybladerf
 from libcpp.atomic cimport atomic
 cimport numpy as cnp
@@ -51,10 +52,6 @@ MAX_BASEBAND_FILTER_BANDWIDTHS = 56_000_000  # MHz
 cdef atomic[uint8_t] working_sdrs[16]
 cdef dict sdr_ids = {}
 
-cdef struct ScanStep:
-    uint64_t frequency
-    uint64_t schedule_time
-
 def sigint_callback_handler(sig, frame, sdr_id):
     global working_sdrs
     working_sdrs[sdr_id].store(0)
@@ -93,9 +90,9 @@ def stop_sdr(serialno: str) -> None:
         working_sdrs[sdr_ids[serialno]].store(0)
 
 
-def pybladerf_scan(frequencies: list[int], samples_per_scan: int, queue: object, sample_rate: int = 61_000_000, baseband_filter_bandwidth: int | None = None,
+def pybladerf_scan(frequencies: list[int], samples_per_scan: int | list[int], queue: object, sample_rate: int = 61_000_000, baseband_filter_bandwidth: int | None = None,
                     gain: int = 20, channel: int = 0, oversample: bool = False, antenna_enable: bool = False, serial_number: str | None = None,
-                    print_to_console: bool = True,
+                    print_to_console: bool = True, calibrate_settle: bool = False, weights: list[int] | None = None,
                     ) -> None:
 
     global working_sdrs, sdr_ids
@@ -159,45 +156,29 @@ def pybladerf_scan(frequencies: list[int], samples_per_scan: int, queue: object,
             sys.stderr.write(f'call pybladerf_set_bias_tee({formated_channel}, True)\n')
         device.pybladerf_set_bias_tee(formated_channel, True)
 
-    num_ranges = len(frequencies) // 2
-    calculated_frequencies = []
-
-    for i in range(num_ranges):
-        frequencies[2 * i] = int(frequencies[2 * i] * 1e6)
-        frequencies[2 * i + 1] = int(frequencies[2 * i + 1] * 1e6)
-
-        if frequencies[2 * i] >= frequencies[2 * i + 1]:
-            device.pybladerf_close()
-            raise RuntimeError('max frequency must be greater than min frequency.')
-
-        step_count = 1 + (frequencies[2 * i + 1] - frequencies[2 * i] - 1) // sample_rate
-        frequencies[2 * i + 1] = int(frequencies[2 * i] + step_count * sample_rate)
-
-        if frequencies[2 * i] < real_min_freq_hz:
-            device.pybladerf_close()
-            raise RuntimeError(f'min frequency must must be greater than {int(real_min_freq_hz / 1e6)} MHz.')
-        if frequencies[2 * i + 1] > real_max_freq_hz:
-            device.pybladerf_close()
-            raise RuntimeError(f'max frequency may not be higher {int(real_max_freq_hz / 1e6)} MHz.')
-
-        frequency = frequencies[2 * i]
-        for j in range(step_count):
-            calculated_frequencies.append(frequency)
-            frequency += sample_rate
-
-        if print_to_console:
-            sys.stderr.write(f'Scaning from {frequencies[2 * i] / 1e6} MHz to {frequencies[2 * i + 1] / 1e6} MHz\n')
-
-    if len(calculated_frequencies) > 256:
+    try:
+        calculated_frequencies, hop_ranges, ranges = expand_frequency_plan(frequencies, sample_rate, real_min_freq_hz, real_max_freq_hz)
+
+        # dwell and revisit weight are given per range and apply to every hop of it
+        if isinstance(samples_per_scan, int):
+            samples_per_scan = [samples_per_scan] * len(ranges)
+        if weights is None:
+            weights = [1] * len(ranges)
+        if len(samples_per_scan) != len(ranges) or len(weights) != len(ranges):
+            raise ValueError('samples_per_scan and weights need one value per frequency range')
+    except Exception:
         device.pybladerf_close()
-        raise RuntimeError('Reached maximum number of RX quick tune profiles. Please reduce the frequency range or increase the sample rate.')
+        raise
 
-    quick_tunes = []
-    for frequency in calculated_frequencies:
-        device.pybladerf_set_frequency(formated_channel, frequency + offset)
+    if print_to_console:
+        for i, (start, stop) in enumerate(ranges):
+            sys.stderr.write(f'Scaning from {start / 1e6} MHz to {stop / 1e6} MHz, {samples_per_scan[i]} samples, weight {weights[i]}\n')
 
-        quick_tune = device.pybladerf_get_quick_tune(formated_channel)
-        quick_tunes.append((frequency, quick_tune))
+    try:
+        quick_tunes = load_quick_tunes(device, formated_channel, calculated_frequencies, offset, sample_rate, print_to_console)
+    except Exception:
+        device.pybladerf_close()
+        raise
 
     device.pybladerf_set_rfic_rx_fir(pybladerf.pybladerf_rfic_rxfir.PYBLADERF_RFIC_RXFIR_BYPASS)
     device.pybladerf_sync_config(
@@ -214,10 +195,6 @@ def pybladerf_scan(frequencies: list[int], samples_per_scan: int, queue: object,
     cdef uint64_t await_time = int(time_1ms * float(os.environ.get('pybladerf_scan_await_time', 1.5)))
     cdef uint16_t tune_steps = len(calculated_frequencies)
 
-    cdef uint8_t free_rffe_profile = 0
-    cdef uint8_t rffe_profiles = min(8, tune_steps)
-
-    cdef uint64_t schedule_timestamp = 0
     cdef double time_start = time.time()
     cdef double time_prev = time.time()
     cdef double timestamp = time.time()
@@ -225,81 +202,67 @@ def pybladerf_scan(frequencies: list[int], samples_per_scan: int, queue: object,
     cdef double scan_rate = 0
     cdef double time_now = 0
     cdef uint64_t scan_count = 0
-    cdef uint32_t tune_step = 0
-
-    cdef uint8_t scan_step_write_ptr = 0
-    cdef uint8_t scan_step_read_ptr = 0
-    cdef ScanStep[8] scan_steps
+    cdef uint64_t accepted_samples = 0
+    cdef uint64_t hop_frequency = 0
+    cdef uint32_t dwell = 0
 
     cdef c_pybladerf.pybladerf_metadata meta = pybladerf.pybladerf_metadata()
 
-    cdef cnp.ndarray buffer = np.empty(samples_per_scan if oversample else samples_per_scan * 2, dtype=np.int8 if oversample else np.int16)
-    cdef double divider = 1 / (128 if oversample else 2048)
-
-    schedule_timestamp = device.pybladerf_get_timestamp(pybladerf.pybladerf_direction.PYBLADERF_RX) + time_1ms * 150
-
-    for i in range(8):
-        quick_tunes[tune_step][1].rffe_profile = free_rffe_profile
-        device.pybladerf_schedule_retune(formated_channel, schedule_timestamp, 0, quick_tunes[tune_step][1])
-
-        scan_steps[scan_step_write_ptr].frequency = quick_tunes[tune_step][0]
-        scan_steps[scan_step_write_ptr].schedule_time = schedule_timestamp + await_time
-        scan_step_write_ptr = (scan_step_write_ptr + 1) % 8
-
-        free_rffe_profile = (free_rffe_profile + 1) % rffe_profiles
-        schedule_timestamp += await_time + samples_per_scan
-        tune_step = (tune_step + 1) % tune_steps
+    cdef cnp.ndarray buffer = np.empty(max(samples_per_scan) * 2, dtype=np.int8 if oversample else np.int16)
+    cdef object to_complex64 = pybladerf.pybladerf_sc8_q7_to_complex64 if oversample else pybladerf.pybladerf_sc16_q11_to_complex64
+
+    # settle times per hop, measured once and kept with the quick tune profiles
+    await_times = [await_time] * tune_steps
+    if calibrate_settle:
+        await_times = load_settle_times(device, formated_channel, calculated_frequencies, offset, sample_rate)
+        if await_times is None:
+            await_times = calibrate_settle_times(device, formated_channel, quick_tunes, sample_rate, await_time, oversample, print_to_console)
+            store_settle_times(device, formated_channel, calculated_frequencies, offset, sample_rate, await_times)
+        elif print_to_console:
+            sys.stderr.write(f'Loaded settle times {min(await_times) / time_1ms:.2f} - {max(await_times) / time_1ms:.2f} ms\n')
+
+    # busy ranges with a higher weight are revisited more often within one scan, their hops spread evenly over it.
+    # retunes are scheduled a few hops ahead of the capture, the lookahead grows on TIME_PAST and shrinks back after a scan without misses
+    try:
+        scheduler = pybladerf.pybladerf_hop_scheduler(
+            device,
+            formated_channel,
+            quick_tunes,
+            [samples_per_scan[hop_range] for hop_range in hop_ranges],
+            await_times,
+            [weights[hop_range] for hop_range in hop_ranges],
+            lookahead=int(os.environ.get('pybladerf_scan_retune_lookahead', 4)),
+            start_lead=time_1ms * 150,
+            recovery_lead=int(time_1ms * float(os.environ.get('pybladerf_scan_recovery_lead', 5))),
+        )
+        scheduler.start()
+    except Exception:
+        device.pybladerf_close()
+        raise
 
     while working_sdrs[device_id].load():
 
-        meta.timestamp = scan_steps[scan_step_read_ptr].schedule_time
+        hop_frequency, meta.timestamp, dwell, _ = scheduler.next()
 
         try:
             timestamp = time.time()
-            device.pybladerf_sync_rx(buffer, samples_per_scan, meta, 0)
+            device.pybladerf_sync_rx(buffer, dwell, meta, 0)
             queue.put({
-                'start_frequency': scan_steps[scan_step_read_ptr].frequency,
-                'stop_frequency': scan_steps[scan_step_read_ptr].frequency + sample_rate,
-                'raw_iq': (buffer[::2] * divider + 1j * buffer[1::2] * divider).astype(np.complex64),
+                'start_frequency': hop_frequency,
+                'stop_frequency': hop_frequency + sample_rate,
+                'raw_iq': to_complex64(buffer[:dwell * 2]),
                 'timestamp': timestamp,
             })
 
-            scan_step_read_ptr = (scan_step_read_ptr + 1) % 8
-
-            quick_tunes[tune_step][1].rffe_profile = free_rffe_profile
-            device.pybladerf_schedule_retune(formated_channel, schedule_timestamp, 0, quick_tunes[tune_step][1])
+            if scheduler.complete():
+                scan_count += 1
 
-            scan_steps[scan_step_write_ptr].frequency = quick_tunes[tune_step][0]
-            scan_steps[scan_step_write_ptr].schedule_time = schedule_timestamp + await_time
-            scan_step_write_ptr = (scan_step_write_ptr + 1) % 8
-
-            free_rffe_profile = (free_rffe_profile + 1) % rffe_profiles
-            schedule_timestamp += await_time + samples_per_scan
-            tune_step = (tune_step + 1) % tune_steps
-
-            accepted_samples += samples_per_scan
+            accepted_samples += dwell
 
         except pybladerf.PYBLADERF_ERR_TIME_PAST:
-            sys.stderr.write("Timestamp is in the past, restarting...\n")
-
-            tune_step = 0
-            free_rffe_profile = 0
-            scan_step_read_ptr = 0
-            scan_step_write_ptr = 0
-
-            schedule_timestamp = device.pybladerf_get_timestamp(pybladerf.pybladerf_direction.PYBLADERF_RX) + time_1ms * 150
-
-            for i in range(8):
-                quick_tunes[tune_step][1].rffe_profile = free_rffe_profile
-                device.pybladerf_schedule_retune(formated_channel, schedule_timestamp, 0, quick_tunes[tune_step][1])
-
-                scan_steps[scan_step_write_ptr].frequency = quick_tunes[tune_step][0]
-                scan_steps[scan_step_write_ptr].schedule_time = schedule_timestamp + await_time
-                scan_step_write_ptr = (scan_step_write_ptr + 1) % 8
-
-                free_rffe_profile = (free_rffe_profile + 1) % rffe_profiles
-                schedule_timestamp += await_time + samples_per_scan
-                tune_step = (tune_step + 1) % tune_steps
+            # only the hops whose capture time went by are lost, the scan resumes at the first of them
+            scheduler.resync()
+            sys.stderr.write(f'Timestamp is in the past, resumed with {scheduler.missed_steps} hops missed, {scheduler.recovered_steps} recovered, lookahead {scheduler.lookahead}\n')
             continue
 
         except pybladerf.PYBLADERF_ERR as ex:
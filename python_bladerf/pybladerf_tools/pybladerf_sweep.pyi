@@ -1,3 +1,5 @@
+import numpy as np
+
 from python_bladerf import pybladerf
 
 def stop_all() -> None:
@@ -6,10 +8,51 @@ def stop_all() -> None:
 def stop_sdr(serialno: str) -> None:
     ...
 
+class PsdKernel:
+    '''
+    Native PSD for one hop: int8/int16 interleaved samples in, float32 dBFS spectrum out.
+    The FFT plan is built once per kernel (pyfftw if installed, otherwise scipy or numpy).
+    With `num_channels` 2 the data is one RX_X2 hop, split natively; the result is the mean power of both channels.
+    '''
+    def __init__(self, fft_size: int, sample_rate: int, oversample: bool, shift: bool, num_channels: int = 1) -> None:
+        ...
+
+    def compute(self, data: np.ndarray, out: np.ndarray | None = None) -> np.ndarray:
+        '''
+        `data` holds at least 2 * fft_size * num_channels int16 (int8 with oversample) values, `out` at least fft_size float32 values.
+        Returns `out`, or a new array when it is None. With `shift` the bins are ordered like numpy.fft.fftshift.
+        '''
+        ...
+
 def pybladerf_sweep(frequencies: list[int] | None = None, sample_rate: int = 61_000_000, baseband_filter_bandwidth: int | None = None,
                     gain: int = 20, bin_width: int = 100_000, channel: int = 0, oversample: bool = False, antenna_enable: bool = False,
                     sweep_style: pybladerf.pybladerf_sweep_style = pybladerf.pybladerf_sweep_style.PYBLADERF_SWEEP_STYLE_INTERLEAVED, serial_number: str | None = None,
                     binary_output: bool = False, one_shot: bool = False, num_sweeps: int | None = None,
                     filename: str | None = None, queue: object | None = None,
-                    print_to_console: bool = True) -> None:
+                    print_to_console: bool = True, native_engine: bool = True,
+                    drop_policy: pybladerf.pybladerf_sweep_drop_policy = pybladerf.pybladerf_sweep_drop_policy.PYBLADERF_SWEEP_DROP_POLICY_BLOCK,
+                    csv_precision: int | None = None, waterfall_filename: str | None = None, waterfall_rows: int = 1024,
+                    calibrate_settle: bool = False, dual_channel: bool = False) -> None:
+    '''
+    With `native_engine` the retune and capture loop runs natively on its own thread without the GIL and only hands captured buffers to Python.
+    Set it to False to use the python loop.
+
+    Captured hops wait for processing in a fixed pool of buffers allocated at startup (`pybladerf_sweep_pool_buffers`, 256 by default).
+    `drop_policy` selects what happens when the pool is exhausted. The default BLOCK never loses a hop, the drop policies are opt-in;
+    dropped hops and the peak backlog are reported every second and dropped hops again at exit.
+
+    `csv_precision` sets the digits after the decimal point of text output bins (default: 10 for interleaved, 2 for linear sweeps).
+    A negative value writes the shortest text that reads back to the same float32 value.
+
+    With `waterfall_filename` spectra go to a memory-mapped WaterfallStore (see utils) instead of the file or queue: one full sweep per row,
+    `waterfall_rows` rows used as a ring. Other processes can read it live with utils.WaterfallReader or np.memmap.
+
+    With `calibrate_settle` the dead time after every retune is measured per hop (see utils.calibrate_settle_times) and the scheduler leaves
+    variable gaps instead of `pybladerf_sweep_await_time` after every hop. The result is kept in the quick tune cache for later runs.
+
+    With `dual_channel` the stream is configured as RX_X2 and every hop is captured on RX0 and RX1 at once (`channel` is ignored).
+    Both chains share one RX LO, so the hops cannot be split between them; instead each output bin is the mean power of the two
+    channels, which halves the variance of every bin. RX_X2 moves twice the data over USB, so `sample_rate` is limited to 30.72 MHz:
+    every hop covers half the span of a 61 MHz single channel sweep and a sweep needs about twice the hops. Not available with oversample.
+    '''
     ...
@@ -24,26 +24,32 @@
 # cython: language_level = 3str
 # cython: freethreading_compatible = True
 try:
-    from pyfftw.interfaces.numpy_fft import fft, fftshift  # type: ignore
+    import pyfftw  # type: ignore
+    FFT_BACKEND = 'pyfftw'
 except ImportError:
     try:
-        from scipy.fft import fft, fftshift  # type: ignore
+        from scipy.fft import fft  # type: ignore
+        FFT_BACKEND = 'scipy'
     except ImportError:
-        from numpy.fft import fft, fftshift  # type: ignore
+        from numpy.fft import fft  # type: ignore
+        FFT_BACKEND = 'numpy'
 
 from python_bladerf.pylibbladerf cimport pybladerf as c_pybladerf
-from libc.stdint cimport uint64_t, uint32_t, uint16_t, uint8_t
+from libc.stdint cimport uint64_t, uint32_t, uint16_t, uint8_t, int16_t, int8_t, uintptr_t
 from python_bladerf.pylibbladerf cimport cbladerf
+from libc.stdlib cimport malloc, calloc, realloc, free
+from libc.string cimport memcpy, memset
+from libcpp cimport bool as c_bool
+from python_bladerf.pybladerf_tools.utils import WaterfallStore, calibrate_settle_times, expand_frequency_plan, load_quick_tunes, load_settle_times, store_settle_times
 from python_bladerf import pybladerf
 from libcpp.atomic cimport atomic
-from queue import Queue
+from queue import Empty, Queue
 cimport numpy as cnp
 import numpy as np
 import threading
 import datetime
 cimport cython
 import signal
-import struct
 import time
 import sys
 import os
@@ -57,6 +63,7 @@ FREQ_MAX_HZ = int(FREQ_MAX_MHZ * 1e6)  # Hz
 
 MIN_SAMPLE_RATE = 520_834
 MAX_SAMPLE_RATE = 61_440_000
+MAX_DUAL_CHANNEL_SAMPLE_RATE = 30_720_000  # RX_X2 SC16_Q11 moves 8 bytes per sample, about 245 MB/s at this rate over USB 3.0
 
 MIN_BASEBAND_FILTER_BANDWIDTHS = 200_000  # MHz
 MAX_BASEBAND_FILTER_BANDWIDTHS = 56_000_000  # MHz
@@ -67,9 +74,75 @@ LINEAR_OFFSET_RATIO = 0.5
 cdef atomic[uint8_t] working_sdrs[16]
 cdef dict sdr_ids = {}
 
-cdef struct SweepStep:
-    uint64_t frequency
-    uint64_t schedule_time
+cdef int BLADERF_ERR_TIME_PAST = -14
+
+cdef extern from *:
+    '''
+    #include <charconv>
+    #include <cstdio>
+
+    // formats bins as "v, v, ..., v\\n"; a negative precision gives the shortest text that reads back to the same float32
+    static inline size_t pybladerf_format_bins(char *out, const float *bins, size_t num_bins, int precision) {
+        char *ptr = out;
+        for (size_t i = 0; i < num_bins; i++) {
+            if (i) {
+                *ptr++ = ',';
+                *ptr++ = ' ';
+            }
+    #if defined(__cpp_lib_to_chars)
+            if (precision < 0)
+                ptr = std::to_chars(ptr, ptr + 64, bins[i]).ptr;
+            else
+                ptr = std::to_chars(ptr, ptr + 64 + precision, (double) bins[i], std::chars_format::fixed, precision).ptr;
+    #else
+            if (precision < 0)
+                ptr += snprintf(ptr, 64, "%.9g", (double) bins[i]);
+            else
+                ptr += snprintf(ptr, 64 + precision, "%.*f", precision, (double) bins[i]);
+    #endif
+        }
+        *ptr++ = '\\n';
+        return (size_t) (ptr - out);
+    }
+    '''
+    size_t pybladerf_format_bins(char *out, const float *bins, size_t num_bins, int precision) nogil
+
+cdef int SWEEP_DROP_POLICY_BLOCK = 0
+cdef int SWEEP_DROP_POLICY_DROP_NEWEST = 1
+cdef int SWEEP_DROP_POLICY_DROP_OLDEST = 2
+
+cdef struct SweepBufferPoolState:
+    uint8_t device_id
+    int policy
+
+    size_t num_buffers
+    size_t buffer_bytes
+    uint8_t *buffers
+    uint8_t *scratch_buffer
+    uint64_t *buffer_frequencies
+    uint64_t *buffer_times
+
+    c_pybladerf.pybladerf_ring filled_ring
+    c_pybladerf.pybladerf_ring free_ring
+    c_pybladerf.pybladerf_signal *filled_signal
+    c_pybladerf.pybladerf_signal *free_signal
+
+    atomic[uint64_t] dropped
+    atomic[size_t] peak_backlog
+
+cdef struct SweepEngineState:
+    cbladerf.bladerf *device
+    uint8_t device_id
+    uint32_t num_samples
+    c_bool one_shot
+    uint64_t num_sweeps
+
+    c_pybladerf.pybladerf_hop_plan *plan
+    SweepBufferPoolState *pool
+
+    atomic[uint64_t] sweep_count
+    atomic[uint64_t] accepted_samples
+    atomic[int] error
 
 def sigint_callback_handler(sig, frame, sdr_id):
     global working_sdrs
@@ -109,31 +182,482 @@ def stop_sdr(serialno: str) -> None:
         working_sdrs[sdr_ids[serialno]].store(0)
 
 
+cdef uint8_t *sweep_pool_acquire(SweepBufferPoolState *pool, size_t *idx) noexcept nogil:
+    # an index of num_buffers means the hop goes to the scratch buffer and is dropped on commit
+    global working_sdrs
+    cdef uint64_t seen
+
+    while True:
+        seen = c_pybladerf.pybladerf_signal_count(pool.free_signal)
+        if c_pybladerf.pybladerf_ring_pop(&pool.free_ring, idx):
+            return pool.buffers + idx[0] * pool.buffer_bytes
+
+        if pool.policy == SWEEP_DROP_POLICY_DROP_OLDEST and c_pybladerf.pybladerf_ring_pop_shared(&pool.filled_ring, idx):
+            pool.dropped.fetch_add(1)
+            return pool.buffers + idx[0] * pool.buffer_bytes
+
+        if pool.policy != SWEEP_DROP_POLICY_BLOCK or not working_sdrs[pool.device_id].load():
+            idx[0] = pool.num_buffers
+            return pool.scratch_buffer
+
+        c_pybladerf.pybladerf_signal_wait(pool.free_signal, seen, 100_000)
+
+
+cdef void sweep_pool_commit(SweepBufferPoolState *pool, size_t idx, uint64_t frequency) noexcept nogil:
+    cdef size_t backlog
+
+    if idx >= pool.num_buffers:
+        pool.dropped.fetch_add(1)
+        return
+
+    pool.buffer_frequencies[idx] = frequency
+    pool.buffer_times[idx] = c_pybladerf.pybladerf_wallclock_us()
+    c_pybladerf.pybladerf_ring_push(&pool.filled_ring, idx)
+    c_pybladerf.pybladerf_signal_notify(pool.filled_signal)
+
+    backlog = pool.num_buffers - c_pybladerf.pybladerf_ring_size(&pool.free_ring)
+    if backlog > pool.peak_backlog.load():
+        pool.peak_backlog.store(backlog)
+
+
 @cython.boundscheck(False)
 @cython.wraparound(False)
-cpdef void process_data(uint8_t device_id,
-                       uint64_t sample_rate,
-                       int sweep_style,
-                       uint8_t oversample,
-                       uint32_t fft_size,
-                       uint8_t binary_output,
-                       object close_ready,
-                       object raw_data_queue,
-                       object empty_raw_data_queue,
-                       object file,
-                       object queue,
-    ):
-
+cdef void sweep_engine_run(SweepEngineState *engine) noexcept nogil:
     global working_sdrs
 
-    cdef cnp.ndarray window = np.hanning(fft_size)
-    cdef double divider = 1 / (128 if oversample else 2048)
+    cdef cbladerf.bladerf_metadata meta
+    cdef c_pybladerf.pybladerf_hop_step *step
+    cdef uint8_t *buffer = NULL
+    cdef size_t idx = 0
+    cdef uint64_t sweep_count
+    cdef int result
+
+    result = c_pybladerf.pybladerf_hop_start(engine.plan)
+
+    while result >= 0 and working_sdrs[engine.device_id].load():
+        # a buffer is kept across failed receives, only the capture thread takes from the free ring
+        if buffer == NULL:
+            buffer = sweep_pool_acquire(engine.pool, &idx)
+
+        result = c_pybladerf.pybladerf_hop_fill(engine.plan)
+        if result < 0:
+            break
+
+        step = &engine.plan.steps[engine.plan.read_ptr]
+        memset(&meta, 0, sizeof(meta))
+        meta.timestamp = step.schedule_time
+
+        result = cbladerf.bladerf_sync_rx(engine.device, buffer, engine.num_samples, &meta, 0)
+        if result < 0:
+            if result == BLADERF_ERR_TIME_PAST:
+                result = c_pybladerf.pybladerf_hop_resync(engine.plan)
+            continue
+
+        sweep_pool_commit(engine.pool, idx, step.frequency)
+        buffer = NULL
+        engine.accepted_samples.fetch_add(engine.num_samples)
+
+        # a sweep is complete once its last hop is captured
+        if c_pybladerf.pybladerf_hop_complete(engine.plan):
+            sweep_count = engine.sweep_count.fetch_add(1) + 1
+            if engine.one_shot or engine.num_sweeps == sweep_count:
+                working_sdrs[engine.device_id].store(0)
+
+    if result < 0:
+        engine.error.store(result)
+        working_sdrs[engine.device_id].store(0)
+
+
+cdef class SweepBufferPool:
+    '''
+    Fixed pool of hop buffers preallocated at startup, shared by the capture loop and the processing pipeline.
+
+    Behaves like the raw/empty data queue pair: get() returns (time_str, frequency, buffer) and put(buffer) gives the buffer back.
+    The capture side takes buffers with acquire() and hands them over with commit(); when the pool is exhausted the drop policy decides
+    whether capture waits, the new hop is dropped or the oldest waiting hop is overwritten.
+    '''
+    cdef SweepBufferPoolState *state
+    cdef list buffer_views
+    cdef cnp.ndarray scratch_view
+    cdef cython.pymutex put_lock
+
+    def __cinit__(self, uint32_t fft_size, uint8_t oversample, size_t num_buffers, int policy, uint8_t device_id, uint8_t num_channels = 1):
+        cdef cnp.npy_intp shape = fft_size * 2 * num_channels
+        cdef size_t i
+
+        if num_buffers == 0:
+            raise ValueError('SweepBufferPool() failed: num_buffers should be at least 1')
+
+        self.state = <SweepBufferPoolState*> calloc(1, sizeof(SweepBufferPoolState))
+        self.state.device_id = device_id
+        self.state.policy = policy
+        self.state.num_buffers = num_buffers
+        self.state.buffer_bytes = fft_size * num_channels * (2 if oversample else 4)
+        self.state.buffers = <uint8_t*> malloc(num_buffers * self.state.buffer_bytes)
+        self.state.scratch_buffer = <uint8_t*> malloc(self.state.buffer_bytes)
+        self.state.buffer_frequencies = <uint64_t*> calloc(num_buffers, sizeof(uint64_t))
+        self.state.buffer_times = <uint64_t*> calloc(num_buffers, sizeof(uint64_t))
+
+        self.state.filled_ring.slots = <size_t*> malloc(num_buffers * sizeof(size_t))
+        self.state.filled_ring.capacity = num_buffers
+        self.state.free_ring.slots = <size_t*> malloc(num_buffers * sizeof(size_t))
+        self.state.free_ring.capacity = num_buffers
+        self.state.filled_signal = c_pybladerf.pybladerf_signal_new()
+        self.state.free_signal = c_pybladerf.pybladerf_signal_new()
+
+        self.buffer_views = []
+        for i in range(num_buffers):
+            c_pybladerf.pybladerf_ring_push(&self.state.free_ring, i)
+            self.buffer_views.append(cnp.PyArray_SimpleNewFromData(1, &shape, cnp.NPY_INT8 if oversample else cnp.NPY_INT16, self.state.buffers + i * self.state.buffer_bytes))
+        self.scratch_view = cnp.PyArray_SimpleNewFromData(1, &shape, cnp.NPY_INT8 if oversample else cnp.NPY_INT16, self.state.scratch_buffer)
+
+    def __dealloc__(self):
+        if self.state != NULL:
+            free(self.state.buffers)
+            free(self.state.scratch_buffer)
+            free(self.state.buffer_frequencies)
+            free(self.state.buffer_times)
+            free(self.state.filled_ring.slots)
+            free(self.state.free_ring.slots)
+            c_pybladerf.pybladerf_signal_free(self.state.filled_signal)
+            c_pybladerf.pybladerf_signal_free(self.state.free_signal)
+            free(self.state)
+            self.state = NULL
+
+    cdef SweepBufferPoolState *get_ptr(self):
+        return self.state
+
+    cdef size_t index_of(self, cnp.ndarray buffer):
+        cdef uintptr_t address = <uintptr_t> cnp.PyArray_DATA(buffer)
+        if address < <uintptr_t> self.state.buffers or address >= <uintptr_t> self.state.buffers + self.state.num_buffers * self.state.buffer_bytes:
+            return self.state.num_buffers
+        return (address - <uintptr_t> self.state.buffers) // self.state.buffer_bytes
+
+    property num_buffers:
+        def __get__(self) -> int:
+            return self.state.num_buffers
+
+    property policy:
+        def __get__(self) -> int:
+            return self.state.policy
+
+    property dropped:
+        def __get__(self) -> int:
+            return self.state.dropped.load()
+
+    property backlog:
+        def __get__(self) -> int:
+            return self.state.num_buffers - c_pybladerf.pybladerf_ring_size(&self.state.free_ring)
+
+    property peak_backlog:
+        def __get__(self) -> int:
+            return self.state.peak_backlog.load()
+
+    def acquire(self) -> np.ndarray:
+        cdef size_t idx
+        with nogil:
+            sweep_pool_acquire(self.state, &idx)
+        return self.buffer_views[idx] if idx < self.state.num_buffers else self.scratch_view
+
+    def commit(self, cnp.ndarray buffer, uint64_t frequency) -> None:
+        sweep_pool_commit(self.state, self.index_of(buffer), frequency)
+
+    def empty(self) -> bool:
+        return c_pybladerf.pybladerf_ring_size(&self.state.filled_ring) == 0
+
+    def get(self, block: bool = True, timeout: float | None = None) -> tuple[str, int, np.ndarray]:
+        cdef uint64_t deadline = c_pybladerf.pybladerf_monotonic_us() + <uint64_t> (timeout * 1e6) if timeout is not None else 0
+        cdef uint64_t wait_us = 100_000
+        cdef uint64_t seen
+        cdef uint64_t now
+        cdef size_t idx
+
+        while True:
+            seen = c_pybladerf.pybladerf_signal_count(self.state.filled_signal)
+            if c_pybladerf.pybladerf_ring_pop_shared(&self.state.filled_ring, &idx):
+                break
+
+            if not block:
+                raise Empty
+
+            if timeout is not None:
+                now = c_pybladerf.pybladerf_monotonic_us()
+                if now >= deadline:
+                    raise Empty
+                wait_us = deadline - now
+
+            with nogil:
+                c_pybladerf.pybladerf_signal_wait(self.state.filled_signal, seen, wait_us)
+
+        time_str = datetime.datetime.fromtimestamp(self.state.buffer_times[idx] / 1e6).strftime('%Y-%m-%d, %H:%M:%S.%f')
+        return time_str, self.state.buffer_frequencies[idx], self.buffer_views[idx]
+
+    def put(self, cnp.ndarray buffer) -> None:
+        cdef size_t idx = self.index_of(buffer)
+        if idx >= self.state.num_buffers:
+            return
+
+        # the free ring has a single producer, processing workers take turns
+        with self.put_lock:
+            c_pybladerf.pybladerf_ring_push(&self.state.free_ring, idx)
+        c_pybladerf.pybladerf_signal_notify(self.state.free_signal)
+
+
+cdef class SweepEngine:
+    '''
+    Native retune and capture loop.
+
+    Runs without the GIL and commits every captured hop to a SweepBufferPool.
+    '''
+    cdef SweepEngineState *state
+    cdef SweepBufferPool pool
+    cdef c_pybladerf.pybladerf_hop_scheduler scheduler
+
+    def __cinit__(self, c_pybladerf.PyBladerfDevice device, uint8_t device_id, c_pybladerf.pybladerf_hop_scheduler scheduler, uint32_t fft_size,
+                  c_bool one_shot, uint64_t num_sweeps, SweepBufferPool pool, uint8_t num_channels = 1):
+        self.pool = pool
+        self.scheduler = scheduler
+        self.state = <SweepEngineState*> calloc(1, sizeof(SweepEngineState))
+        self.state.device = device.get_ptr()
+        self.state.device_id = device_id
+        # RX_X2 reads count the samples of both channels
+        self.state.num_samples = fft_size * num_channels
+        self.state.one_shot = one_shot
+        self.state.num_sweeps = num_sweeps
+        self.state.plan = scheduler.get_ptr()
+        self.state.pool = pool.get_ptr()
+
+    def __dealloc__(self):
+        if self.state != NULL:
+            free(self.state)
+            self.state = NULL
+
+    property sweep_count:
+        def __get__(self) -> int:
+            return self.state.sweep_count.load()
+
+    property error:
+        def __get__(self) -> int:
+            return self.state.error.load()
+
+    def take_accepted_samples(self) -> int:
+        return self.state.accepted_samples.exchange(0)
+
+    def run(self) -> None:
+        with nogil:
+            sweep_engine_run(self.state)
+
+
+cdef class PsdKernel:
+    '''
+    Turns one hop of interleaved SC16_Q11/SC8_Q7 samples into a float32 dBFS spectrum.
+    Conversion, DC removal and windowing run in a single native pass, the FFT plan is built once per kernel and the log-power stage writes straight into the output.
+    With two channels the RX_X2 hop is split natively, and the output is the mean power of both channel spectra.
+    '''
+    cdef uint32_t fft_size
+    cdef uint8_t oversample
+    cdef uint8_t num_channels
+    cdef int shift
+    cdef float norm
+    cdef cnp.ndarray window
+    cdef cnp.ndarray iq
+    cdef cnp.ndarray spectrum
+    cdef cnp.ndarray channels
+    cdef cnp.ndarray first_spectrum
+    cdef object plan
+
+    def __cinit__(self, uint32_t fft_size, uint64_t sample_rate, uint8_t oversample, c_bool shift, uint8_t num_channels = 1):
+        hanning = np.hanning(fft_size)
+
+        if num_channels not in (1, 2):
+            raise ValueError('PsdKernel() failed: num_channels should be 1 or 2')
+
+        self.fft_size = fft_size
+        self.oversample = oversample
+        self.num_channels = num_channels
+        self.shift = 1 if shift else 0
+        self.norm = 1 / (sample_rate * np.dot(hanning, hanning) * num_channels)
+        self.window = np.repeat(hanning / (128 if oversample else 2048), 2).astype(np.float32)
+        if num_channels == 2:
+            self.channels = np.empty(fft_size * 4, dtype=np.int8 if oversample else np.int16)
+            self.first_spectrum = np.empty(fft_size, dtype=np.complex64)
+
+        if FFT_BACKEND == 'pyfftw':
+            self.iq = pyfftw.empty_aligned(fft_size, dtype=np.complex64)
+            self.spectrum = pyfftw.empty_aligned(fft_size, dtype=np.complex64)
+            self.plan = pyfftw.FFTW(self.iq, self.spectrum, flags=('FFTW_MEASURE',), threads=1)
+        else:
+            self.iq = np.empty(fft_size, dtype=np.complex64)
+            self.spectrum = np.empty(fft_size, dtype=np.complex64)
+            self.plan = None
+
+    cdef void prepare(self, const void *samples) noexcept nogil:
+        if self.oversample:
+            c_pybladerf.pybladerf_psd_prepare[int8_t](<int8_t*> samples, <float*> cnp.PyArray_DATA(self.window), <float*> cnp.PyArray_DATA(self.iq), self.fft_size)
+        else:
+            c_pybladerf.pybladerf_psd_prepare[int16_t](<int16_t*> samples, <float*> cnp.PyArray_DATA(self.window), <float*> cnp.PyArray_DATA(self.iq), self.fft_size)
+
+    cdef cnp.ndarray transform(self):
+        if self.plan is not None:
+            self.plan()
+            return self.spectrum
+        if FFT_BACKEND == 'scipy':
+            return np.ascontiguousarray(fft(self.iq, overwrite_x=True), dtype=np.complex64)
+        try:
+            return fft(self.iq, out=self.spectrum)
+        except TypeError:
+            return np.ascontiguousarray(fft(self.iq), dtype=np.complex64)
+
+    @cython.boundscheck(False)
+    @cython.wraparound(False)
+    def compute(self, cnp.ndarray data, cnp.ndarray out = None) -> np.ndarray:
+        cdef cnp.ndarray spectrum
+        cdef void *samples
+        cdef void *second
+        cdef size_t values = self.fft_size * 2
+
+        if not data.flags.c_contiguous or data.dtype != (np.int8 if self.oversample else np.int16) or data.size < values * self.num_channels:
+            raise ValueError(f'data should be a contiguous {"int8" if self.oversample else "int16"} array of at least {values * self.num_channels} values')
+
+        if out is None:
+            out = np.empty(self.fft_size, dtype=np.float32)
+        elif not out.flags.c_contiguous or out.dtype != np.float32 or out.size < self.fft_size:
+            raise ValueError(f'out should be a contiguous float32 array of at least {self.fft_size} values')
+
+        samples = cnp.PyArray_DATA(data)
+        if self.num_channels == 2:
+            with nogil:
+                if self.oversample:
+                    c_pybladerf.pybladerf_deinterleave_x2[int8_t](<int8_t*> samples, <int8_t*> cnp.PyArray_DATA(self.channels), (<int8_t*> cnp.PyArray_DATA(self.channels)) + values, self.fft_size)
+                else:
+                    c_pybladerf.pybladerf_deinterleave_x2[int16_t](<int16_t*> samples, <int16_t*> cnp.PyArray_DATA(self.channels), (<int16_t*> cnp.PyArray_DATA(self.channels)) + values, self.fft_size)
+                self.prepare(cnp.PyArray_DATA(self.channels))
+
+            spectrum = self.transform()
+            second = (<int8_t*> cnp.PyArray_DATA(self.channels)) + values * (1 if self.oversample else 2)
+            with nogil:
+                memcpy(cnp.PyArray_DATA(self.first_spectrum), cnp.PyArray_DATA(spectrum), self.fft_size * 8)
+                self.prepare(second)
+
+            spectrum = self.transform()
+            with nogil:
+                c_pybladerf.pybladerf_psd_power_sum(<float*> cnp.PyArray_DATA(self.first_spectrum), <float*> cnp.PyArray_DATA(spectrum), <float*> cnp.PyArray_DATA(out), self.fft_size, self.norm, self.shift)
+            return out
+
+        with nogil:
+            self.prepare(samples)
+
+        spectrum = self.transform()
+        with nogil:
+            c_pybladerf.pybladerf_psd_power(<float*> cnp.PyArray_DATA(spectrum), <float*> cnp.PyArray_DATA(out), self.fft_size, self.norm, self.shift)
+
+        return out
+
+
+cdef inline size_t sweep_pack_record(uint8_t *out, uint64_t start_frequency, uint64_t stop_frequency, const float *bins, uint32_t num_bins) noexcept nogil:
+    # hackrf_sweep layout: uint32 record_length, uint64 start, uint64 stop, float32 bins
+    cdef uint32_t record_length = 16 + num_bins * 4
+
+    memcpy(out, &record_length, 4)
+    memcpy(out + 4, &start_frequency, 8)
+    memcpy(out + 12, &stop_frequency, 8)
+    memcpy(out + 20, bins, num_bins * 4)
+    return 20 + num_bins * 4
+
+
+cdef class SweepOutputWriter:
+    '''
+    Collects sweep output in one large reusable native buffer and hands it to the file in batches.
+    Binary records and text rows are encoded straight from the float32 spectrum, the file only sees a write when the buffer fills up or drain() is called. Only flush() flushes the file itself.
+    '''
+    cdef object file
+    cdef uint8_t *buffer
+    cdef size_t capacity
+    cdef size_t size
+    cdef cnp.ndarray view
+
+    def __cinit__(self, object file, size_t capacity):
+        self.file = file
+        self.capacity = 0
+        self.size = 0
+        self.reserve(max(capacity, 4096))
+
+    def __dealloc__(self):
+        free(self.buffer)
+        self.buffer = NULL
+
+    cdef void reserve(self, size_t capacity):
+        cdef cnp.npy_intp shape
+        cdef uint8_t *buffer
+
+        if capacity <= self.capacity:
+            return
 
-    cdef cnp.ndarray data
-    cdef cnp.ndarray raw_iq
-    cdef cnp.ndarray fftOut
-    cdef cnp.ndarray dbfs
-    cdef double psd_norm = 1 / (sample_rate * np.dot(window, window))
+        buffer = <uint8_t*> realloc(self.buffer, capacity)
+        if buffer == NULL:
+            raise MemoryError('SweepOutputWriter() failed: unable to allocate output buffer')
+
+        self.buffer = buffer
+        self.capacity = capacity
+        shape = capacity
+        self.view = cnp.PyArray_SimpleNewFromData(1, &shape, cnp.NPY_UINT8, self.buffer)
+
+    property pending_bytes:
+        def __get__(self) -> int:
+            return self.size
+
+    def write_record(self, uint64_t start_frequency, uint64_t stop_frequency, cnp.ndarray bins, uint32_t start = 0, uint32_t stop = 0) -> None:
+        cdef uint32_t num_bins
+        cdef size_t record_size
+
+        if bins.dtype != np.float32 or not bins.flags.c_contiguous:
+            raise ValueError('bins should be a contiguous float32 array')
+
+        if stop == 0:
+            stop = bins.size
+        num_bins = stop - start
+        record_size = 20 + num_bins * 4
+
+        if self.size + record_size > self.capacity:
+            self.drain()
+            self.reserve(record_size)
+
+        self.size += sweep_pack_record(self.buffer + self.size, start_frequency, stop_frequency, (<float*> cnp.PyArray_DATA(bins)) + start, num_bins)
+
+    def write_row(self, bytes prefix, cnp.ndarray bins, uint32_t start = 0, uint32_t stop = 0, int precision = 10) -> None:
+        cdef uint32_t num_bins
+        cdef size_t row_size
+        cdef size_t prefix_size = len(prefix)
+
+        if bins.dtype != np.float32 or not bins.flags.c_contiguous:
+            raise ValueError('bins should be a contiguous float32 array')
+
+        if stop == 0:
+            stop = bins.size
+        num_bins = stop - start
+        precision = min(precision, 30)
+        row_size = prefix_size + num_bins * (64 + max(precision, 0)) + 1
+
+        if self.size + row_size > self.capacity:
+            self.drain()
+            self.reserve(row_size)
+
+        memcpy(self.buffer + self.size, <char*> prefix, prefix_size)
+        self.size += prefix_size
+        self.size += pybladerf_format_bins(<char*> (self.buffer + self.size), (<float*> cnp.PyArray_DATA(bins)) + start, num_bins, precision)
+
+    def drain(self) -> None:
+        if self.size:
+            self.file.write(self.view[:self.size])
+            self.size = 0
+
+    def flush(self) -> None:
+        self.drain()
+        self.file.flush()
+
+
+cdef void write_spectrum(uint64_t sample_rate, int sweep_style, uint32_t fft_size, uint8_t binary_output, int csv_precision, SweepOutputWriter writer, object queue,
+                         object waterfall, str time_str, uint64_t frequency, cnp.ndarray pwr):
 
     cdef uint32_t fft_1_start = 1 + (fft_size * 5) // 8
     cdef uint32_t fft_1_stop = 1 + (fft_size * 5) // 8 + fft_size // 4
@@ -141,89 +665,275 @@ cpdef void process_data(uint8_t device_id,
     cdef uint32_t fft_2_start = 1 + fft_size // 8
     cdef uint32_t fft_2_stop = 1 + fft_size // 8 + fft_size // 4
 
-    cdef uint64_t frequency = 0
-    cdef str time_str
+    if waterfall is not None:
+        if sweep_style == pybladerf.pybladerf_sweep_style.PYBLADERF_SWEEP_STYLE_INTERLEAVED:
+            waterfall.write(time_str, frequency, [(frequency, pwr[fft_1_start:fft_1_stop]), (frequency + sample_rate // 2, pwr[fft_2_start:fft_2_stop])])
+        else:
+            waterfall.write(time_str, frequency, [(frequency, pwr)])
+
+    elif binary_output:
+        if sweep_style == pybladerf.pybladerf_sweep_style.PYBLADERF_SWEEP_STYLE_INTERLEAVED:
+            writer.write_record(frequency, frequency + sample_rate // 4, pwr, fft_1_start, fft_1_stop)
+            writer.write_record(frequency + sample_rate // 2, frequency + (sample_rate * 3) // 4, pwr, fft_2_start, fft_2_stop)
+        else:
+            writer.write_record(frequency, frequency + sample_rate, pwr)
 
-    while working_sdrs[device_id].load():
+    elif queue is not None:
+        if sweep_style == pybladerf.pybladerf_sweep_style.PYBLADERF_SWEEP_STYLE_INTERLEAVED:
+            queue.put({
+                'timestamp': time_str,
+                'start_frequency': frequency,
+                'stop_frequency': frequency + sample_rate // 4,
+                'dbfs': pwr[fft_1_start:fft_1_stop],
+            })
+            queue.put({
+                'timestamp': time_str,
+                'start_frequency': frequency + sample_rate // 2,
+                'stop_frequency': frequency + (sample_rate * 3) // 4,
+                'dbfs': pwr[fft_2_start:fft_2_stop],
+            })
 
-        if raw_data_queue.empty():
-            time.sleep(.035)
-            continue
+        else:
+            queue.put({
+                'timestamp': time_str,
+                'start_frequency': frequency,
+                'stop_frequency': frequency + sample_rate,
+                'dbfs': pwr,
+            })
 
-        time_str, frequency, data = raw_data_queue.get()
+    else:
+        if sweep_style == pybladerf.pybladerf_sweep_style.PYBLADERF_SWEEP_STYLE_INTERLEAVED:
+            writer.write_row(f'{time_str}, {frequency}, {frequency + sample_rate // 4}, {sample_rate / fft_size}, {fft_size}, '.encode(), pwr, fft_1_start, fft_1_stop, csv_precision)
+            writer.write_row(f'{time_str}, {frequency + sample_rate // 2}, {frequency + (sample_rate * 3) // 4}, {sample_rate / fft_size}, {fft_size}, '.encode(), pwr, fft_2_start, fft_2_stop, csv_precision)
+        else:
+            writer.write_row(f'{time_str}, {frequency}, {frequency + sample_rate}, {sample_rate / fft_size}, {fft_size}, '.encode(), pwr, 0, 0, csv_precision)
+
+
+cdef class SweepPipeline:
+    '''
+    Spreads the PSD work of captured hops over a pool of processing workers.
+    A dispatcher numbers hops in capture order and feeds a bounded, blocking work queue; every worker owns a PsdKernel,
+    and a reorder stage hands spectra to the output strictly in hop order.
+    '''
+    cdef uint8_t device_id
+    cdef uint64_t sample_rate
+    cdef int sweep_style
+    cdef uint8_t oversample
+    cdef uint32_t fft_size
+    cdef uint8_t num_channels
+    cdef uint8_t binary_output
+    cdef int csv_precision
+
+    cdef object close_ready
+    cdef object raw_data_queue
+    cdef object empty_raw_data_queue
+    cdef object file
+    cdef object queue
+    cdef object waterfall
+    cdef SweepOutputWriter writer
+
+    cdef int num_workers
+    cdef int queue_depth
+    cdef double flush_interval
+    cdef object work_queue
+    cdef object reorder
+    cdef dict pending
+    cdef int finished_workers
+    cdef list worker_hops
+    cdef list reported_hops
+    cdef double reported_time
+    cdef object error
+
+    def __init__(self, uint8_t device_id, uint64_t sample_rate, int sweep_style, uint8_t oversample, uint32_t fft_size, uint8_t binary_output, int csv_precision,
+                 object close_ready, object raw_data_queue, object empty_raw_data_queue, object file, object queue, object waterfall, int num_workers, int queue_depth,
+                 uint8_t num_channels = 1):
+        self.device_id = device_id
+        self.num_channels = num_channels
+        self.sample_rate = sample_rate
+        self.sweep_style = sweep_style
+        self.oversample = oversample
+        self.fft_size = fft_size
+        self.binary_output = binary_output
+        self.csv_precision = csv_precision
+
+        self.close_ready = close_ready
+        self.raw_data_queue = raw_data_queue
+        self.empty_raw_data_queue = empty_raw_data_queue
+        self.file = file
+        self.queue = queue
+        self.waterfall = waterfall
+        self.writer = None
+        if waterfall is None and (binary_output or queue is None):
+            self.writer = SweepOutputWriter(file, int(os.environ.get('pybladerf_sweep_output_buffer_size', 4 * 1024 * 1024)))
+
+        self.num_workers = max(1, num_workers)
+        self.queue_depth = max(1, queue_depth)
+        self.flush_interval = float(os.environ.get('pybladerf_sweep_output_flush_interval', 0.1))
+        self.work_queue = Queue(maxsize=self.queue_depth)
+        self.reorder = threading.Condition()
+        self.pending = {}
+        self.finished_workers = 0
+        self.worker_hops = [0] * self.num_workers
+        self.reported_hops = [0] * self.num_workers
+        self.reported_time = time.time()
+        self.error = None
+
+    property num_workers:
+        def __get__(self) -> int:
+            return self.num_workers
+
+    property queue_depth:
+        def __get__(self) -> int:
+            return self.queue_depth
+
+    property queued:
+        def __get__(self) -> int:
+            return self.work_queue.qsize()
+
+    property reorder_backlog:
+        def __get__(self) -> int:
+            return len(self.pending)
+
+    property error:
+        def __get__(self) -> BaseException | None:
+            return self.error
+
+    def _fail(self, error: BaseException) -> None:
+        global working_sdrs
+
+        # the first failure is kept and stops the capture, the pipeline still drains and shuts down
+        with self.reorder:
+            if self.error is None:
+                self.error = error
+        working_sdrs[self.device_id].store(0)
+
+    def worker_rates(self) -> list[float]:
+        '''
+        Hops per second of every worker since the previous call.
+        '''
+        cdef double time_now = time.time()
+        cdef double elapsed = max(time_now - self.reported_time, 1e-6)
+        hops = list(self.worker_hops)
+        rates = [(hops[i] - self.reported_hops[i]) / elapsed for i in range(self.num_workers)]
+        self.reported_hops = hops
+        self.reported_time = time_now
+        return rates
+
+    def _dispatch(self) -> None:
+        global working_sdrs
+        cdef uint64_t seq = 0
+
+        # once capture stops, hops that were already captured are still drained
+        while True:
+            try:
+                time_str, frequency, data = self.raw_data_queue.get(timeout=.1)
+            except Empty:
+                if not working_sdrs[self.device_id].load():
+                    break
+                continue
+
+            self.work_queue.put((seq, time_str, frequency, data))
+            seq += 1
+
+        for i in range(self.num_workers):
+            self.work_queue.put(None)
+
+    def _work(self, int index) -> None:
+        cdef PsdKernel psd_kernel
+        cdef cnp.ndarray pwr
+        data = None
 
-        raw_iq = data[::2] * divider + 1j * data[1::2] * divider
-        empty_raw_data_queue.put(data)
+        try:
+            psd_kernel = PsdKernel(self.fft_size, self.sample_rate, self.oversample, self.sweep_style == pybladerf.pybladerf_sweep_style.PYBLADERF_SWEEP_STYLE_LINEAR, self.num_channels)
+
+            while True:
+                item = self.work_queue.get()
+                if item is None:
+                    break
+
+                seq, time_str, frequency, data = item
+                pwr = psd_kernel.compute(data)
+                self.empty_raw_data_queue.put(data)
+                data = None
+
+                with self.reorder:
+                    self.pending[seq] = (time_str, frequency, pwr)
+                    self.reorder.notify()
+                self.worker_hops[index] += 1
+
+        except BaseException as ex:
+            self._fail(ex)
+            if data is not None:
+                self.empty_raw_data_queue.put(data)
+
+            # the dispatcher blocks on a full work queue, so the remaining hops are still taken off it
+            while True:
+                item = self.work_queue.get()
+                if item is None:
+                    break
+                self.empty_raw_data_queue.put(item[3])
+
+        finally:
+            with self.reorder:
+                self.finished_workers += 1
+                self.reorder.notify()
+
+    def run(self) -> None:
+        cdef uint64_t next_seq = 0
+        cdef double last_output = time.monotonic()
+        cdef double idle_time
+
+        threads = [threading.Thread(target=self._dispatch, daemon=True)]
+        threads += [threading.Thread(target=self._work, args=(i,), daemon=True) for i in range(self.num_workers)]
+        for thread in threads:
+            thread.start()
 
-        fft_out = fft((raw_iq - raw_iq.mean()) * window)
-        dbfs = np.log10((fft_out.real**2 + fft_out.imag**2) * psd_norm + 1e-300) * 10.0
+        try:
+            while True:
+                with self.reorder:
+                    ready = next_seq in self.pending
 
-        if sweep_style == pybladerf.pybladerf_sweep_style.PYBLADERF_SWEEP_STYLE_LINEAR:
-            pwr = fftshift(pwr)
+                    # batched output is only written out after flush_interval without a new hop, so a slow hop rate does not hold records back
+                    while not ready and self.finished_workers < self.num_workers:
+                        if self.writer is None or self.writer.pending_bytes == 0:
+                            self.reorder.wait()
+                        else:
+                            idle_time = time.monotonic() - last_output
+                            if idle_time >= self.flush_interval:
+                                break
+                            self.reorder.wait(self.flush_interval - idle_time)
+                        ready = next_seq in self.pending
 
-        if binary_output:
-            if sweep_style == pybladerf.pybladerf_sweep_style.PYBLADERF_SWEEP_STYLE_INTERLEAVED:
-                record_length = 16 + (fft_size // 4) * 4
-                line = struct.pack('I', record_length)
-                line += struct.pack('Q', frequency)
-                line += struct.pack('Q', frequency + sample_rate // 4)
-                line += struct.pack('<' + 'f' * (fft_size // 4), *pwr[fft_1_start:fft_1_stop])
-                line += struct.pack('I', record_length)
-                line += struct.pack('Q', frequency + sample_rate // 2)
-                line += struct.pack('Q', frequency + (sample_rate * 3) // 4)
-                line += struct.pack('<' + 'f' * (fft_size // 4), *pwr[fft_2_start:fft_2_stop])
+                    if ready:
+                        time_str, frequency, pwr = self.pending.pop(next_seq)
+                    elif self.finished_workers >= self.num_workers:
+                        break
 
-            else:
-                record_length = 16 + fft_size * 4
-                line = struct.pack('I', record_length)
-                line += struct.pack('Q', frequency)
-                line += struct.pack('Q', frequency + sample_rate)
-                line += struct.pack('<' + 'f' * fft_size, *pwr)
-
-            file.write(line)
-
-        elif queue is not None:
-            if sweep_style == pybladerf.pybladerf_sweep_style.PYBLADERF_SWEEP_STYLE_INTERLEAVED:
-                queue.put({
-                    'timestamp': time_str,
-                    'start_frequency': frequency,
-                    'stop_frequency': frequency + sample_rate // 4,
-                    'dbfs': pwr[fft_1_start:fft_1_stop].astype(np.float32),
-                })
-                queue.put({
-                    'timestamp': time_str,
-                    'start_frequency': frequency + sample_rate // 2,
-                    'stop_frequency': frequency + (sample_rate * 3) // 4,
-                    'dbfs': pwr[fft_2_start:fft_2_stop].astype(np.float32),
-                })
+                if not ready:
+                    self.writer.drain()
+                    continue
 
-            else:
-                queue.put({
-                    'timestamp': time_str,
-                    'start_frequency': frequency,
-                    'stop_frequency': frequency + sample_rate,
-                    'dbfs': pwr.astype(np.float32),
-                })
+                next_seq += 1
+                write_spectrum(self.sample_rate, self.sweep_style, self.fft_size, self.binary_output, self.csv_precision, self.writer, self.queue, self.waterfall, time_str, frequency, pwr)
+                last_output = time.monotonic()
 
-        else:
-            if sweep_style == pybladerf.pybladerf_sweep_style.PYBLADERF_SWEEP_STYLE_INTERLEAVED:
-                line = f'{time_str}, {frequency}, {frequency + sample_rate // 4}, {sample_rate / fft_size}, {fft_size}, '
-                for value in pwr[fft_1_start:fft_1_stop]:
-                    line += f'{value:.10f}, '
-                line += f'\n{time_str}, {frequency + sample_rate // 2}, {frequency + (sample_rate * 3) // 4}, {sample_rate / fft_size}, {fft_size}, '
-                for value in pwr[fft_2_start:fft_2_stop]:
-                    line += f'{value:.10f}, '
-                line = line[:len(line) - 2] + '\n'
+            if self.writer is not None:
+                self.writer.flush()
 
-            else:
-                line = f'{time_str}, {frequency}, {frequency + sample_rate}, {sample_rate / fft_size}, {fft_size}, '
-                for i in range(len(pwr)):
-                    line += f'{pwr[i]:.2f}, '
-                line = line[:len(line) - 2] + '\n'
+        except BaseException as ex:
+            self._fail(ex)
+
+        finally:
+            try:
+                if self.waterfall is not None:
+                    self.waterfall.close()
+            except BaseException as ex:
+                self._fail(ex)
 
-            file.write(line)
+            for thread in threads:
+                thread.join()
 
-    close_ready.set()
+            self.close_ready.set()
 
 
 def pybladerf_sweep(frequencies: list[int] | None = None, sample_rate: int = 61_000_000, baseband_filter_bandwidth: int | None = None,
@@ -231,13 +941,17 @@ def pybladerf_sweep(frequencies: list[int] | None = None, sample_rate: int = 61_
                     sweep_style: pybladerf.pybladerf_sweep_style = pybladerf.pybladerf_sweep_style.PYBLADERF_SWEEP_STYLE_INTERLEAVED, serial_number: str | None = None,
                     binary_output: bool = False, one_shot: bool = False, num_sweeps: int | None = None,
                     filename: str | None = None, queue: object | None = None,
-                    print_to_console: bool = True,
-                    ) -> None:
+                    print_to_console: bool = True, native_engine: bool = True,
+                    drop_policy: pybladerf.pybladerf_sweep_drop_policy = pybladerf.pybladerf_sweep_drop_policy.PYBLADERF_SWEEP_DROP_POLICY_BLOCK,
+                    csv_precision: int | None = None, waterfall_filename: str | None = None, waterfall_rows: int = 1024,
+                    calibrate_settle: bool = False, dual_channel: bool = False) -> None:
 
     global working_sdrs, sdr_ids
 
     cdef uint8_t device_id = init_signals()
-    cdef uint8_t formated_channel = pybladerf.PYBLADERF_CHANNEL_RX(channel)
+    # both RX chains share the RX LO, so in dual channel mode retunes go to RX0 and every hop is captured on both
+    cdef uint8_t formated_channel = pybladerf.PYBLADERF_CHANNEL_RX(0 if dual_channel else channel)
+    cdef uint8_t num_channels = 2 if dual_channel else 1
     cdef c_pybladerf.PyBladerfDevice device
     cdef uint64_t offset = 0
 
@@ -249,6 +963,11 @@ def pybladerf_sweep(frequencies: list[int] | None = None, sample_rate: int = 61_
     working_sdrs[device_id].store(1)
     sdr_ids[device.serialno] = device_id
 
+    if dual_channel and (oversample or device.pybladerf_get_channel_count(pybladerf.pybladerf_direction.PYBLADERF_RX) < 2):
+        device.pybladerf_close()
+        raise RuntimeError('dual_channel needs a device with two RX channels and is not supported with oversample')
+    rx_channels = [pybladerf.PYBLADERF_CHANNEL_RX(i) for i in range(2)] if dual_channel else [formated_channel]
+
     device.pybladerf_enable_feature(pybladerf.pybladerf_feature.PYBLADERF_FEATURE_OVERSAMPLE, False)
 
     if oversample:
@@ -256,6 +975,11 @@ def pybladerf_sweep(frequencies: list[int] | None = None, sample_rate: int = 61_
     else:
         sample_rate = int(sample_rate) if MIN_SAMPLE_RATE <= int(sample_rate) <= MAX_SAMPLE_RATE else 61_000_000
 
+    if dual_channel and sample_rate > MAX_DUAL_CHANNEL_SAMPLE_RATE:
+        if print_to_console:
+            sys.stderr.write(f'dual_channel streams two channels over USB, sample rate limited to {MAX_DUAL_CHANNEL_SAMPLE_RATE / 1e6 :.3f} MHz\n')
+        sample_rate = MAX_DUAL_CHANNEL_SAMPLE_RATE
+
     real_min_freq_hz = FREQ_MIN_HZ - sample_rate // 2
     real_max_freq_hz = FREQ_MAX_HZ + sample_rate // 2
 
@@ -289,56 +1013,26 @@ def pybladerf_sweep(frequencies: list[int] | None = None, sample_rate: int = 61_
             sys.stderr.write(f'call pybladerf_set_bandwidth({formated_channel}, {baseband_filter_bandwidth / 1e6 :.3f} MHz)\n')
         device.pybladerf_set_bandwidth(formated_channel, baseband_filter_bandwidth)
 
-    if print_to_console:
-        sys.stderr.write(f'call pybladerf_set_gain_mode({formated_channel}, {pybladerf.pybladerf_gain_mode.PYBLADERF_GAIN_MGC})\n')
-    device.pybladerf_set_gain_mode(formated_channel, pybladerf.pybladerf_gain_mode.PYBLADERF_GAIN_MGC)
-    device.pybladerf_set_gain(formated_channel, gain)
-
-    if antenna_enable:
+    for rx_channel in rx_channels:
         if print_to_console:
-            sys.stderr.write(f'call pybladerf_set_bias_tee({formated_channel}, True)\n')
-        device.pybladerf_set_bias_tee(formated_channel, True)
-
-    num_ranges = len(frequencies) // 2
-    calculated_frequencies = []
-
-    for i in range(num_ranges):
-        frequencies[2 * i] = int(frequencies[2 * i] * 1e6)
-        frequencies[2 * i + 1] = int(frequencies[2 * i + 1] * 1e6)
-
-        if frequencies[2 * i] >= frequencies[2 * i + 1]:
-            device.pybladerf_close()
-            raise RuntimeError('max frequency must be greater than min frequency.')
-
-        step_count = 1 + (frequencies[2 * i + 1] - frequencies[2 * i] - 1) // sample_rate
-        frequencies[2 * i + 1] = int(frequencies[2 * i] + step_count * sample_rate)
-
-        if frequencies[2 * i] < real_min_freq_hz:
-            device.pybladerf_close()
-            raise RuntimeError(f'min frequency must must be greater than {int(real_min_freq_hz / 1e6)} MHz.')
-        if frequencies[2 * i + 1] > real_max_freq_hz:
-            device.pybladerf_close()
-            raise RuntimeError(f'max frequency may not be higher {int(real_max_freq_hz / 1e6)} MHz.')
+            sys.stderr.write(f'call pybladerf_set_gain_mode({rx_channel}, {pybladerf.pybladerf_gain_mode.PYBLADERF_GAIN_MGC})\n')
+        device.pybladerf_set_gain_mode(rx_channel, pybladerf.pybladerf_gain_mode.PYBLADERF_GAIN_MGC)
+        device.pybladerf_set_gain(rx_channel, gain)
 
-        frequency = frequencies[2 * i]
-        if sweep_style == pybladerf.pybladerf_sweep_style.PYBLADERF_SWEEP_STYLE_INTERLEAVED:
-            for j in range(step_count * 2):
-                calculated_frequencies.append(frequency)
-                if j % 2 == 0:
-                    frequency += int(sample_rate / 4)
-                else:
-                    frequency += int(3 * sample_rate / 4)
-        else:
-            for j in range(step_count):
-                calculated_frequencies.append(frequency)
-                frequency += sample_rate
-
-        if print_to_console:
-            sys.stderr.write(f'Sweeping from {frequencies[2 * i] / 1e6} MHz to {frequencies[2 * i + 1] / 1e6} MHz\n')
+        if antenna_enable:
+            if print_to_console:
+                sys.stderr.write(f'call pybladerf_set_bias_tee({rx_channel}, True)\n')
+            device.pybladerf_set_bias_tee(rx_channel, True)
 
-    if len(calculated_frequencies) > 256:
+    try:
+        calculated_frequencies, _, ranges = expand_frequency_plan(frequencies, sample_rate, real_min_freq_hz, real_max_freq_hz, sweep_style == pybladerf.pybladerf_sweep_style.PYBLADERF_SWEEP_STYLE_INTERLEAVED)
+    except Exception:
         device.pybladerf_close()
-        raise RuntimeError('Reached maximum number of RX quick tune profiles. Please reduce the frequency range or increase the sample rate.')
+        raise
+
+    if print_to_console:
+        for start, stop in ranges:
+            sys.stderr.write(f'Sweeping from {start / 1e6} MHz to {stop / 1e6} MHz\n')
 
     cdef uint32_t fft_size = int(sample_rate / bin_width)
     if fft_size < 4:
@@ -348,169 +1042,207 @@ def pybladerf_sweep(frequencies: list[int] | None = None, sample_rate: int = 61_
     while ((fft_size + 4) % 8):
         fft_size += 1
 
-    quick_tunes = []
-    for frequency in calculated_frequencies:
-        device.pybladerf_set_frequency(formated_channel, frequency + offset)
+    try:
+        quick_tunes = load_quick_tunes(device, formated_channel, calculated_frequencies, offset, sample_rate, print_to_console)
+    except Exception:
+        device.pybladerf_close()
+        raise
 
-        quick_tune = device.pybladerf_get_quick_tune(formated_channel)
-        quick_tunes.append((frequency, quick_tune))
+    cdef uint64_t time_1ms = int(sample_rate // 1000)
+    cdef uint64_t await_time = int(time_1ms * float(os.environ.get('pybladerf_sweep_await_time', 1.5)))
+    cdef uint64_t time_past_resets = 0
 
-    raw_data_queue = Queue()
-    empty_raw_data_queue = Queue()
+    pool = SweepBufferPool(
+        fft_size,
+        1 if oversample else 0,
+        int(os.environ.get('pybladerf_sweep_pool_buffers', 256)),
+        drop_policy if drop_policy in pybladerf.pybladerf_sweep_drop_policy else pybladerf.pybladerf_sweep_drop_policy.PYBLADERF_SWEEP_DROP_POLICY_BLOCK,
+        device_id,
+        num_channels,
+    )
 
-    file = open(filename, 'w' if not binary_output else 'wb') if filename is not None else (sys.stdout.buffer if binary_output else sys.stdout)
+    # text rows are encoded natively as well, so both outputs go through the binary handle
+    file = open(filename, 'wb') if filename is not None else sys.stdout.buffer
     close_ready = threading.Event()
 
     device.pybladerf_set_rfic_rx_fir(pybladerf.pybladerf_rfic_rxfir.PYBLADERF_RFIC_RXFIR_BYPASS)
     device.pybladerf_sync_config(
-        layout=pybladerf.pybladerf_channel_layout.PYBLADERF_RX_X1,
+        layout=pybladerf.pybladerf_channel_layout.PYBLADERF_RX_X2 if dual_channel else pybladerf.pybladerf_channel_layout.PYBLADERF_RX_X1,
         data_format=pybladerf.pybladerf_format.PYBLADERF_FORMAT_SC8_Q7_META if oversample else pybladerf.pybladerf_format.PYBLADERF_FORMAT_SC16_Q11_META,
         num_buffers=int(os.environ.get('pybladerf_sweep_num_buffers', 4096)),
         buffer_size=int(os.environ.get('pybladerf_sweep_buffer_size', 8192)),
         num_transfers=int(os.environ.get('pybladerf_sweep_num_transfers', 64)),
         stream_timeout=0,
     )
-    device.pybladerf_enable_module(formated_channel, True)
+    for rx_channel in rx_channels:
+        device.pybladerf_enable_module(rx_channel, True)
+
+    # settle times per hop, measured once and kept with the quick tune profiles
+    await_times = [await_time] * len(quick_tunes)
+    if calibrate_settle:
+        await_times = load_settle_times(device, formated_channel, calculated_frequencies, offset, sample_rate, num_channels)
+        if await_times is None:
+            await_times = calibrate_settle_times(device, formated_channel, quick_tunes, sample_rate, await_time, oversample, print_to_console, num_channels)
+            store_settle_times(device, formated_channel, calculated_frequencies, offset, sample_rate, await_times, num_channels)
+        elif print_to_console:
+            sys.stderr.write(f'Loaded settle times {min(await_times) / time_1ms:.2f} - {max(await_times) / time_1ms:.2f} ms\n')
+
+    # retunes are scheduled a few hops ahead of the capture, the lookahead grows on TIME_PAST and shrinks back after a sweep without misses
+    scheduler = pybladerf.pybladerf_hop_scheduler(
+        device,
+        formated_channel,
+        quick_tunes,
+        fft_size,
+        await_times,
+        lookahead=int(os.environ.get('pybladerf_sweep_retune_lookahead', 4)),
+        start_lead=time_1ms * 150,
+        recovery_lead=int(time_1ms * float(os.environ.get('pybladerf_sweep_recovery_lead', 5))),
+    )
+
+    if native_engine:
+        engine = SweepEngine(
+            device,
+            device_id,
+            scheduler,
+            fft_size,
+            one_shot,
+            num_sweeps if num_sweeps is not None else 0,
+            pool,
+            num_channels,
+        )
+
+    processing_style = sweep_style if sweep_style in pybladerf.pybladerf_sweep_style else pybladerf.pybladerf_sweep_style.PYBLADERF_SWEEP_STYLE_INTERLEAVED
+
+    waterfall = None
+    if waterfall_filename is not None:
+        segments = []
+        for frequency in calculated_frequencies:
+            if processing_style == pybladerf.pybladerf_sweep_style.PYBLADERF_SWEEP_STYLE_INTERLEAVED:
+                segments.append((frequency, frequency + sample_rate // 4, fft_size // 4))
+                segments.append((frequency + sample_rate // 2, frequency + (sample_rate * 3) // 4, fft_size // 4))
+            else:
+                segments.append((frequency, frequency + sample_rate, fft_size))
 
-    processing_thread = threading.Thread(target=process_data, args=(
+        waterfall = WaterfallStore(waterfall_filename, waterfall_rows, segments, fft_size, sample_rate, processing_style, calculated_frequencies)
+        if print_to_console:
+            sys.stderr.write(f'Writing waterfall to {waterfall_filename} ({waterfall.num_rows} rows x {waterfall.num_bins} bins)\n')
+
+    pipeline = SweepPipeline(
         device_id,
         sample_rate,
-        sweep_style if sweep_style in pybladerf.pybladerf_sweep_style else pybladerf.pybladerf_sweep_style.PYBLADERF_SWEEP_STYLE_INTERLEAVED,
+        processing_style,
         1 if oversample else 0,
         fft_size,
         1 if binary_output else 0,
+        csv_precision if csv_precision is not None else (2 if sweep_style == pybladerf.pybladerf_sweep_style.PYBLADERF_SWEEP_STYLE_LINEAR else 10),
         close_ready,
-        raw_data_queue,
-        empty_raw_data_queue,
+        pool,
+        pool,
         file,
         queue,
-    ), daemon=True)
+        waterfall,
+        int(os.environ.get('pybladerf_sweep_workers', min(4, os.cpu_count() or 1))),
+        int(os.environ.get('pybladerf_sweep_queue_depth', 64)),
+        num_channels,
+    )
+    processing_thread = threading.Thread(target=pipeline.run, daemon=True)
     processing_thread.start()
 
-    cdef uint64_t time_1ms = int(sample_rate // 1000)
-    cdef uint64_t await_time = int(time_1ms * float(os.environ.get('pybladerf_sweep_await_time', 1.5)))
-    cdef uint16_t tune_steps = len(calculated_frequencies)
+    if print_to_console:
+        sys.stderr.write(f'Processing with {pipeline.num_workers} workers, work queue depth {pipeline.queue_depth}\n')
 
     cdef double time_start = time.time()
     cdef double time_prev = time.time()
-    cdef uint8_t free_rffe_profile = 0
-    cdef uint8_t rffe_profiles = min(8, tune_steps)
-
-    cdef uint64_t schedule_timestamp = 0
     cdef uint64_t accepted_samples = 0
     cdef double time_difference = 0
     cdef uint64_t sweep_count = 0
-    cdef uint16_t tune_step = 0
     cdef double sweep_rate = 0
     cdef double time_now = 0
 
-    cdef uint8_t sweep_step_write_ptr = 0
-    cdef uint8_t sweep_step_read_ptr = 0
-    cdef SweepStep[8] sweep_steps
+    cdef uint64_t hop_frequency = 0
 
-    cdef cnp.ndarray buffer
+    cdef cnp.ndarray buffer = None
 
     cdef c_pybladerf.pybladerf_metadata meta = pybladerf.pybladerf_metadata()
 
-    schedule_timestamp = device.pybladerf_get_timestamp(pybladerf.pybladerf_direction.PYBLADERF_RX) + time_1ms * 150
-
-    for i in range(8):
-        quick_tunes[tune_step][1].rffe_profile = free_rffe_profile
-        device.pybladerf_schedule_retune(formated_channel, schedule_timestamp, 0, quick_tunes[tune_step][1])
-
-        sweep_steps[sweep_step_write_ptr].frequency = quick_tunes[tune_step][0]
-        sweep_steps[sweep_step_write_ptr].schedule_time = schedule_timestamp + await_time
-        sweep_step_write_ptr = (sweep_step_write_ptr + 1) % 8
-
-        free_rffe_profile = (free_rffe_profile + 1) % rffe_profiles
-        schedule_timestamp += await_time + fft_size
-        tune_step = (tune_step + 1) % tune_steps
-
-    while working_sdrs[device_id].load():
-        if empty_raw_data_queue.empty():
-            buffer = np.empty(fft_size if oversample else fft_size * 2, dtype=np.int8 if oversample else np.int16)
-        else:
-            buffer = empty_raw_data_queue.get()
-
-        meta.timestamp = sweep_steps[sweep_step_read_ptr].schedule_time
-
-        try:
-            device.pybladerf_sync_rx(buffer, fft_size, meta, 0)
-            raw_data_queue.put(
-                (
-                    datetime.datetime.now().strftime('%Y-%m-%d, %H:%M:%S.%f'),
-                    sweep_steps[sweep_step_read_ptr].frequency,
-                    buffer,
-                )
-            )
-
-            sweep_step_read_ptr = (sweep_step_read_ptr + 1) % 8
-
-            quick_tunes[tune_step][1].rffe_profile = free_rffe_profile
-            device.pybladerf_schedule_retune(formated_channel, schedule_timestamp, 0, quick_tunes[tune_step][1])
-
-            sweep_steps[sweep_step_write_ptr].frequency = quick_tunes[tune_step][0]
-            sweep_steps[sweep_step_write_ptr].schedule_time = schedule_timestamp + await_time
-            sweep_step_write_ptr = (sweep_step_write_ptr + 1) % 8
-
-            free_rffe_profile = (free_rffe_profile + 1) % rffe_profiles
-            schedule_timestamp += await_time + fft_size
-            tune_step = (tune_step + 1) % tune_steps
-
-            accepted_samples += fft_size
-
-        except pybladerf.PYBLADERF_ERR_TIME_PAST:
-            sys.stderr.write("Timestamp is in the past, restarting...\n")
+    if native_engine:
+        engine_thread = threading.Thread(target=engine.run, daemon=True)
+        engine_thread.start()
 
-            tune_step = 0
-            free_rffe_profile = 0
-            sweep_step_read_ptr = 0
-            sweep_step_write_ptr = 0
+        while working_sdrs[device_id].load():
+            time.sleep(.05)
 
-            schedule_timestamp = device.pybladerf_get_timestamp(pybladerf.pybladerf_direction.PYBLADERF_RX) + time_1ms * 150
-            empty_raw_data_queue.put(buffer)
+            if scheduler.time_past_resets != time_past_resets:
+                time_past_resets = scheduler.time_past_resets
+                sys.stderr.write(f'Timestamp is in the past, resumed with {scheduler.missed_steps} hops missed, {scheduler.recovered_steps} recovered, lookahead {scheduler.lookahead}\n')
 
-            for i in range(8):
-                quick_tunes[tune_step][1].rffe_profile = free_rffe_profile
-                device.pybladerf_schedule_retune(formated_channel, schedule_timestamp, 0, quick_tunes[tune_step][1])
-
-                sweep_steps[sweep_step_write_ptr].frequency = quick_tunes[tune_step][0]
-                sweep_steps[sweep_step_write_ptr].schedule_time = schedule_timestamp + await_time
-                sweep_step_write_ptr = (sweep_step_write_ptr + 1) % 8
+            sweep_count = engine.sweep_count
+            time_now = time.time()
+            time_difference = time_now - time_prev
+            if time_difference >= 1.0:
+                if print_to_console:
+                    sweep_rate = sweep_count / (time_now - time_start)
+                    sys.stderr.write(f'{sweep_count} total sweeps completed, {round(sweep_rate, 2)} sweeps/second\n')
+                    sys.stderr.write(f'{pipeline.queued}/{pipeline.queue_depth} hops queued, {" ".join(str(round(rate, 1)) for rate in pipeline.worker_rates())} hops/second per worker\n')
+                    sys.stderr.write(f'{pool.backlog}/{pool.num_buffers} buffers in use, peak {pool.peak_backlog}, {pool.dropped} hops dropped\n')
 
-                free_rffe_profile = (free_rffe_profile + 1) % rffe_profiles
-                schedule_timestamp += await_time + fft_size
-                tune_step = (tune_step + 1) % tune_steps
+                if engine.take_accepted_samples() == 0:
+                    if print_to_console:
+                        sys.stderr.write("Couldn\'t transfer any data for one second.\n")
+                    break
 
-            continue
-
-        except pybladerf.PYBLADERF_ERR as ex:
-            sys.stderr.write("pybladerf_sync_rx() failed: %s %d", cbladerf.bladerf_strerror(ex.code), ex.code)
-            working_sdrs[device_id].store(0)
-            break
+                time_prev = time_now
 
+    else:
+        scheduler.start()
+
+        while working_sdrs[device_id].load():
+            # a buffer is kept across failed receives
+            if buffer is None:
+                buffer = pool.acquire()
+
+            hop_frequency, meta.timestamp, _, _ = scheduler.next()
+
+            try:
+                device.pybladerf_sync_rx(buffer, fft_size * num_channels, meta, 0)
+                pool.commit(buffer, hop_frequency)
+                buffer = None
+                accepted_samples += fft_size * num_channels
+
+            except pybladerf.PYBLADERF_ERR_TIME_PAST:
+                # only the hops whose capture time went by are lost, the sweep resumes at the first of them
+                scheduler.resync()
+                sys.stderr.write(f'Timestamp is in the past, resumed with {scheduler.missed_steps} hops missed, {scheduler.recovered_steps} recovered, lookahead {scheduler.lookahead}\n')
+                continue
+
+            except pybladerf.PYBLADERF_ERR as ex:
+                sys.stderr.write("pybladerf_sync_rx() failed: %s %d", cbladerf.bladerf_strerror(ex.code), ex.code)
+                working_sdrs[device_id].store(0)
+                break
 
-        if tune_step == 0:
-            sweep_count += 1
+            # a sweep is complete once its last hop is captured
+            if scheduler.complete():
+                sweep_count += 1
 
-            if one_shot or (num_sweeps == sweep_count):
-                if sweep_count:
+                if one_shot or (num_sweeps == sweep_count):
                     working_sdrs[device_id].store(0)
 
-        time_now = time.time()
-        time_difference = time_now - time_prev
-        if time_difference >= 1.0:
-            if print_to_console:
-                sweep_rate = sweep_count / (time_now - time_start)
-                sys.stderr.write(f'{sweep_count} total sweeps completed, {round(sweep_rate, 2)} sweeps/second\n')
-
-            if accepted_samples == 0:
+            time_now = time.time()
+            time_difference = time_now - time_prev
+            if time_difference >= 1.0:
                 if print_to_console:
-                    sys.stderr.write("Couldn\'t transfer any data for one second.\n")
-                break
+                    sweep_rate = sweep_count / (time_now - time_start)
+                    sys.stderr.write(f'{sweep_count} total sweeps completed, {round(sweep_rate, 2)} sweeps/second\n')
+                    sys.stderr.write(f'{pipeline.queued}/{pipeline.queue_depth} hops queued, {" ".join(str(round(rate, 1)) for rate in pipeline.worker_rates())} hops/second per worker\n')
+                    sys.stderr.write(f'{pool.backlog}/{pool.num_buffers} buffers in use, peak {pool.peak_backlog}, {pool.dropped} hops dropped\n')
+
+                if accepted_samples == 0:
+                    if print_to_console:
+                        sys.stderr.write("Couldn\'t transfer any data for one second.\n")
+                    break
 
-            accepted_samples = 0
-            time_prev = time_now
+                accepted_samples = 0
+                time_prev = time_now
 
     if print_to_console:
         if not working_sdrs[device_id].load():
@@ -519,6 +1251,12 @@ def pybladerf_sweep(frequencies: list[int] | None = None, sample_rate: int = 61_
             sys.stderr.write('\nExiting... [ pybladerf streaming stopped ]\n')
 
     working_sdrs[device_id].store(0)
+    if native_engine:
+        engine_thread.join()
+        sweep_count = engine.sweep_count
+        if engine.error < 0:
+            sys.stderr.write(f'pybladerf_sync_rx() failed: {cbladerf.bladerf_strerror(engine.error).decode("utf-8")} {engine.error}\n')
+
     close_ready.wait()
     sdr_ids.pop(device.serialno, None)
 
@@ -532,21 +1270,28 @@ def pybladerf_sweep(frequencies: list[int] | None = None, sample_rate: int = 61_
 
     if print_to_console:
         sys.stderr.write(f'Total sweeps: {sweep_count} in {time_now - time_start:.5f} seconds ({sweep_rate :.2f} sweeps/second)\n')
+        if pool.dropped:
+            sys.stderr.write(f'{pool.dropped} hops dropped by the {pybladerf.pybladerf_sweep_drop_policy(drop_policy).name} policy\n')
+
+    for rx_channel in rx_channels:
+        if antenna_enable:
+            try:
+                device.pybladerf_set_bias_tee(rx_channel, False)
+            except Exception as ex:
+                    sys.stderr.write(f'{ex}\n')
 
-    if antenna_enable:
         try:
-            device.pybladerf_set_bias_tee(formated_channel, False)
+            device.pybladerf_enable_module(rx_channel, False)
         except Exception as ex:
                 sys.stderr.write(f'{ex}\n')
 
-    try:
-        device.pybladerf_enable_module(formated_channel, False)
-    except Exception as ex:
-            sys.stderr.write(f'{ex}\n')
-
     try:
         device.pybladerf_close()
         if print_to_console:
             sys.stderr.write('pybladerf_close() done\n')
     except Exception as ex:
         sys.stderr.write(f'{ex}\n')
+
+    # a processing failure stopped the sweep, it is raised once the device is closed
+    if pipeline.error is not None:
+        raise pipeline.error
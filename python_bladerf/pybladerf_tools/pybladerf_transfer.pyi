@@ -1,3 +1,5 @@
+from python_bladerf import pybladerf
+
 def stop_all() -> None:
     ...
 
@@ -8,5 +10,22 @@ def pybladerf_transfer(frequency: int | None = None, sample_rate: int = 10_000_0
                        gain: int = 0, channel: int = 0, oversample: bool = False, antenna_enable: bool = False,
                        repeat_tx: bool = False, synchronize: bool = False, num_samples: int | None = None, serial_number: str | None = None,
                        rx_filename: str | None = None, tx_filename: str | None = None, rx_buffer: object | None = None, tx_buffer: object | None = None,
-                       print_to_console: bool = True) -> None:
+                       print_to_console: bool = True, raw_format: bool = False, stats: pybladerf.pybladerf_iq_stats | None = None,
+                       compression: pybladerf.pybladerf_iq_codec | None = None, compression_bits: int = 8,
+                       tx_frequency: int | None = None, tx_gain: int | None = None, tx_stats: pybladerf.pybladerf_iq_stats | None = None,
+                       align_start: bool = False) -> None:
+    '''
+    Pass a pybladerf_iq_stats as `stats` to poll power, peak, clipping and DC offset of the stream from another thread
+    (for example for automatic gain control). The console report does not reset a caller's statistics.
+
+    With `compression` the RX file is a compressed raw recording (see utils.CompressedFileWriter), `compression_bits` is the mantissa width of
+    PYBLADERF_IQ_CODEC_BFP. TX in raw format replays compressed recordings as well, they are recognized by their header.
+
+    Given both an RX and a TX file or buffer the transfer runs full duplex: each direction has its own stream buffers and thread,
+    TX uses `tx_frequency` and `tx_gain` (default `frequency` and `gain`) and `tx_stats`, and the transfer ends when either direction finishes.
+    The streams are timestamped, RX overruns and TX underruns are counted with the samples they lost (TX checks the device clock
+    every `pybladerf_transfer_underrun_check_interval` ms). RX and TX timestamps come from separate counters, with `align_start` their offset
+    is measured over USB and both directions start at the same instant to within that measurement, not sample-exact.
+    Raw RX headers then carry both start timestamps and the uncertainty in samples (`align_uncertainty`).
+        '''
     ...
@@ -23,8 +23,9 @@
 # distutils: language = c++
 # cython: language_level = 3str
 # cython: freethreading_compatible = True
-from libc.stdint cimport uint64_t, uint32_t, uint16_t, uint8_t, uintptr_t
+from libc.stdint cimport int64_t, uint64_t, uint32_t, uint16_t, uint8_t, uintptr_t
 from python_bladerf.pylibbladerf cimport pybladerf as c_pybladerf
+from python_bladerf.pybladerf_tools.utils import CompressedFileReader, CompressedFileWriter, RawFileWriter, is_compressed_file, read_raw_header, write_raw_header
 from python_bladerf import pybladerf
 from libcpp cimport bool as c_bool
 from libcpp.atomic cimport atomic
@@ -61,10 +62,28 @@ cdef dict sdr_ids = {}
 
 cdef struct TransferStatus:
     atomic[uint64_t] byte_count
-    atomic[uint64_t] stream_power
+    # RX overruns or TX underruns and the samples lost to them, counted on timestamped (full-duplex) streams
+    atomic[uint64_t] xrun_count
+    atomic[uint64_t] xrun_samples
+    uint64_t next_timestamp
+    uint64_t resync_lead
+    # TX reads the device clock to detect underruns only once every check_interval samples
+    uint64_t next_check
+    uint64_t check_interval
     c_bool tx_complete
 
 
+cdef inline void reset_transfer_status(TransferStatus* transfer_status) noexcept:
+    transfer_status.byte_count.store(0)
+    transfer_status.xrun_count.store(0)
+    transfer_status.xrun_samples.store(0)
+    transfer_status.next_timestamp = 0
+    transfer_status.resync_lead = 0
+    transfer_status.next_check = 0
+    transfer_status.check_interval = 0
+    transfer_status.tx_complete = False
+
+
 def sigint_callback_handler(sig, frame, sdr_id):
     global working_sdrs
     working_sdrs[sdr_id].store(0)
@@ -108,39 +127,66 @@ def stop_sdr(serialno: str) -> None:
 cpdef void rx_process(c_pybladerf.PyBladerfDevice device,
                       uint8_t device_id,
                       uintptr_t transfer_status_ptr,
-                      uint8_t channel,
+                      c_pybladerf.pybladerf_iq_stats stats,
                       uint8_t oversample,
+                      uint8_t raw_format,
                       object close_ready,
                       object rx_buffer,
                       object file,
-                      int num_samples):
+                      int num_samples,
+                      c_pybladerf.pybladerf_metadata meta):
 
     global working_sdrs
 
     cdef TransferStatus* transfer_status = <TransferStatus*> transfer_status_ptr
 
     cdef uint64_t to_read
+    cdef uint64_t expected_timestamp = 0
     cdef cnp.ndarray accepted_data
 
     cdef uint64_t samples_per_transfer = int(os.environ.get('pybladerf_transfer_samples_per_transfer', 65536))
-    cdef double divider = 1 / (128 if oversample else 2048)
     cdef uint8_t bytes_per_sample = 2 if oversample else 4
-    cdef cnp.ndarray buffer = np.empty(samples_per_transfer * 2, dtype=np.int8 if oversample else np.int16)
+    cdef object dtype = np.int8 if oversample else np.int16
+    cdef cnp.ndarray buffer = None
+    cdef cnp.ndarray converted = None
+    cdef object to_complex64 = pybladerf.pybladerf_sc8_q7_to_complex64 if oversample else pybladerf.pybladerf_sc16_q11_to_complex64
 
-    device.pybladerf_enable_module(channel, True)
-    while working_sdrs[device_id].load():
-        device.pybladerf_sync_rx(buffer, samples_per_transfer, None, 0)
+    # raw recordings receive straight into the writer's blocks
+    if not raw_format:
+        buffer = np.empty(samples_per_transfer * 2, dtype=dtype)
+        converted = np.empty(samples_per_transfer, dtype=np.complex64)
 
-        transfer_status.byte_count.fetch_add(samples_per_transfer * bytes_per_sample)
-        transfer_status.stream_power.fetch_add(np.sum(buffer[:samples_per_transfer * 2].astype(np.int32) ** 2))
+    while working_sdrs[device_id].load():
+        if raw_format:
+            buffer = file.reserve(samples_per_transfer * bytes_per_sample).view(dtype)
+        device.pybladerf_sync_rx(buffer, samples_per_transfer, meta, 0)
         to_read = samples_per_transfer
 
+        # a timestamped read stops short at an overrun and the next one starts after the gap
+        if meta is not None:
+            to_read = meta.actual_count
+            if expected_timestamp and meta.timestamp > expected_timestamp:
+                transfer_status.xrun_count.fetch_add(1)
+                transfer_status.xrun_samples.fetch_add(meta.timestamp - expected_timestamp)
+            expected_timestamp = meta.timestamp + to_read
+            meta.flags = pybladerf.PYBLADERF_META_FLAG_RX_NOW
+
+        transfer_status.byte_count.fetch_add(to_read * bytes_per_sample)
+        stats.update_ptr(cnp.PyArray_DATA(buffer), to_read)
+
         if num_samples:
             if (to_read > num_samples):
                 to_read = num_samples
             num_samples -= to_read
 
-        accepted_data = (buffer[:to_read * 2:2] * divider + 1j * buffer[1:to_read * 2:2] * divider).astype(np.complex64)
+        if raw_format:
+            file.commit(to_read * bytes_per_sample)
+            if num_samples == 0:
+                working_sdrs[device_id].store(0)
+            continue
+
+        # rx_buffer may keep a reference to the chunk, so it gets a fresh array
+        accepted_data = to_complex64(buffer[:to_read * 2], None if rx_buffer is not None else converted)
 
         if rx_buffer is not None:
             rx_buffer.append(accepted_data)
@@ -153,18 +199,73 @@ cpdef void rx_process(c_pybladerf.PyBladerfDevice device,
     close_ready.set()
 
 
+# returns (offset, uncertainty) in samples, a TX timestamp is the RX timestamp of the same instant + offset ± uncertainty
+cdef tuple measure_tx_offset(c_pybladerf.PyBladerfDevice device, int rounds):
+    cdef uint64_t rx_before = 0
+    cdef uint64_t rx_after = 0
+    cdef uint64_t tx = 0
+    cdef uint64_t width = 0
+    cdef uint64_t best_width = 0
+    cdef int64_t offset = 0
+
+    # the TX clock is read between two RX reads, the narrowest bracket gives the best estimate
+    for i in range(max(1, rounds)):
+        rx_before = device.pybladerf_get_timestamp(pybladerf.pybladerf_direction.PYBLADERF_RX)
+        tx = device.pybladerf_get_timestamp(pybladerf.pybladerf_direction.PYBLADERF_TX)
+        rx_after = device.pybladerf_get_timestamp(pybladerf.pybladerf_direction.PYBLADERF_RX)
+        width = rx_after - rx_before
+        if i == 0 or width < best_width:
+            best_width = width
+            offset = <int64_t> tx - <int64_t> (rx_before + width // 2)
+
+    return offset, (best_width + 1) // 2
+
+
+cdef inline void decode_tx_data(bytes raw_data, cnp.ndarray out, uint8_t raw_format, object from_complex64):
+    if raw_format:
+        out[:] = np.frombuffer(raw_data, dtype=out.dtype, count=out.size)
+    else:
+        from_complex64(np.frombuffer(raw_data, dtype=np.complex64, count=out.size // 2), out)
+
+
+cdef inline void send_tx_data(c_pybladerf.PyBladerfDevice device, TransferStatus* transfer_status, c_pybladerf.pybladerf_iq_stats stats,
+                              c_pybladerf.pybladerf_metadata meta, cnp.ndarray buffer, uint64_t count, uint8_t bytes_per_sample):
+    cdef uint64_t now = 0
+
+    # once the device clock passes the next queued sample the TX FIFO has run dry, the burst goes on a little ahead of it
+    if meta is not None and meta.flags != pybladerf.PYBLADERF_META_FLAG_TX_BURST_START and transfer_status.next_timestamp >= transfer_status.next_check:
+        transfer_status.next_check = transfer_status.next_timestamp + transfer_status.check_interval
+        now = device.pybladerf_get_timestamp(pybladerf.pybladerf_direction.PYBLADERF_TX)
+        if now >= transfer_status.next_timestamp:
+            transfer_status.xrun_count.fetch_add(1)
+            transfer_status.xrun_samples.fetch_add(now - transfer_status.next_timestamp)
+            transfer_status.next_timestamp = now + transfer_status.resync_lead
+            meta.timestamp = transfer_status.next_timestamp
+            meta.flags = pybladerf.PYBLADERF_META_FLAG_TX_UPDATE_TIMESTAMP
+
+    device.pybladerf_sync_tx(buffer, count, meta, 0)
+    if meta is not None:
+        meta.flags = 0
+        transfer_status.next_timestamp += count
+
+    transfer_status.byte_count.fetch_add(count * bytes_per_sample)
+    stats.update_ptr(cnp.PyArray_DATA(buffer), count)
+
+
 @cython.boundscheck(False)
 @cython.wraparound(False)
 cpdef void tx_process(c_pybladerf.PyBladerfDevice device,
                       uint8_t device_id,
                       uintptr_t transfer_status_ptr,
-                      uint8_t channel,
+                      c_pybladerf.pybladerf_iq_stats stats,
                       uint8_t oversample,
                       uint8_t repeat_tx,
+                      uint8_t raw_format,
                       object close_ready,
                       object tx_buffer,
                       object file,
-                      int num_samples):
+                      int num_samples,
+                      c_pybladerf.pybladerf_metadata meta):
 
     global working_sdrs
 
@@ -175,14 +276,13 @@ cpdef void tx_process(c_pybladerf.PyBladerfDevice device,
     cdef uint64_t to_write = 0
     cdef uint64_t rewrited = 0
     cdef cnp.ndarray sent_data
-    cdef cnp.ndarray scaled_data
     cdef uint8_t bytes_per_sample = 2 if oversample else 4
+    cdef uint8_t file_sample_bytes = bytes_per_sample if raw_format else 8
     cdef uint32_t samples_per_transfer = int(os.environ.get('pybladerf_transfer_samples_per_transfer', 65536))
-    cdef uint16_t divider = 128 if oversample else 2048
     cdef object dtype = np.int8 if oversample else np.int16
     cdef cnp.ndarray buffer = np.empty(samples_per_transfer * 2, dtype=dtype)
+    cdef object from_complex64 = pybladerf.pybladerf_complex64_to_sc8_q7 if oversample else pybladerf.pybladerf_complex64_to_sc16_q11
 
-    device.pybladerf_enable_module(channel, True)
     while working_sdrs[device_id].load():
         to_write = samples_per_transfer
 
@@ -203,13 +303,9 @@ cpdef void tx_process(c_pybladerf.PyBladerfDevice device,
                 working_sdrs[device_id].store(0)
                 break
 
-            scaled_data = (sent_data.view(np.float32) * divider).astype(dtype)
-            buffer[0:writed * 2:2] = scaled_data[0::2]
-            buffer[1:writed * 2:2] = scaled_data[1::2]
+            from_complex64(sent_data, buffer[:writed * 2])
 
-            device.pybladerf_sync_tx(buffer, writed, None, 0)
-            transfer_status.byte_count.fetch_add(writed * bytes_per_sample)
-            transfer_status.stream_power.fetch_add(np.sum(buffer[:writed * 2].astype(np.int32) ** 2))
+            send_tx_data(device, transfer_status, stats, meta, buffer, writed, bytes_per_sample)
 
             # limit samples
             if num_samples == 0:
@@ -217,9 +313,9 @@ cpdef void tx_process(c_pybladerf.PyBladerfDevice device,
                 working_sdrs[device_id].store(0)
 
         else:
-            raw_data = file.read(to_write * 8)
+            raw_data = file.read(to_write * file_sample_bytes)
             if len(raw_data):
-                writed = len(raw_data) // 8
+                writed = len(raw_data) // file_sample_bytes
             elif file.tell() < 1:
                 # file is empty
                 working_sdrs[device_id].store(0)
@@ -227,33 +323,23 @@ cpdef void tx_process(c_pybladerf.PyBladerfDevice device,
             else:
                 writed = 0
 
-            sent_data = np.frombuffer(raw_data, dtype=np.complex64)
-            
-            scaled_data = (sent_data.view(np.float32) * divider).astype(dtype)
-            buffer[0:writed * 2:2] = scaled_data[0::2]
-            buffer[1:writed * 2:2] = scaled_data[1::2]
+            decode_tx_data(raw_data, buffer[:writed * 2], raw_format, from_complex64)
 
             # limit samples
             if num_samples == 0:
-                device.pybladerf_sync_tx(buffer, writed, None, 0)
-                transfer_status.byte_count.fetch_add(writed * bytes_per_sample)
-                transfer_status.stream_power.fetch_add(np.sum(buffer[:writed * 2].astype(np.int32) ** 2))
+                send_tx_data(device, transfer_status, stats, meta, buffer, writed, bytes_per_sample)
                 transfer_status.tx_complete = True
                 working_sdrs[device_id].store(0)
                 continue
 
             # buffer is full
             if to_write == writed:
-                device.pybladerf_sync_tx(buffer, writed, None, 0)
-                transfer_status.byte_count.fetch_add(writed * bytes_per_sample)
-                transfer_status.stream_power.fetch_add(np.sum(buffer[:writed * 2].astype(np.int32) ** 2))
+                send_tx_data(device, transfer_status, stats, meta, buffer, writed, bytes_per_sample)
                 continue
 
             # file is finished
             if not repeat_tx:
-                device.pybladerf_sync_tx(buffer, writed, None, 0)
-                transfer_status.byte_count.fetch_add(writed * bytes_per_sample)
-                transfer_status.stream_power.fetch_add(np.sum(buffer[:writed * 2].astype(np.int32) ** 2))
+                send_tx_data(device, transfer_status, stats, meta, buffer, writed, bytes_per_sample)
                 transfer_status.tx_complete = True
                 working_sdrs[device_id].store(0)
                 continue
@@ -261,43 +347,85 @@ cpdef void tx_process(c_pybladerf.PyBladerfDevice device,
             # repeat file
             while writed < to_write:
                 file.seek(0)
-                raw_data = file.read((to_write - writed) * 8)
+                raw_data = file.read((to_write - writed) * file_sample_bytes)
                 if len(raw_data):
-                    rewrited = len(raw_data) // 8
+                    rewrited = len(raw_data) // file_sample_bytes
                 else:
-                    device.pybladerf_sync_tx(buffer, writed, None, 0)
-                    transfer_status.byte_count.fetch_add(writed * bytes_per_sample)
-                    transfer_status.stream_power.fetch_add(np.sum(buffer[:writed * 2].astype(np.int32) ** 2))
+                    send_tx_data(device, transfer_status, stats, meta, buffer, writed, bytes_per_sample)
                     transfer_status.tx_complete = True
                     working_sdrs[device_id].store(0)
                     continue
 
-                sent_data = np.frombuffer(raw_data, dtype=np.complex64)
-                scaled_data = (sent_data.view(np.float32) * divider).astype(dtype)
-                buffer[writed * 2:(writed + rewrited) * 2:2] = scaled_data[0::2]
-                buffer[writed * 2 + 1:(writed + rewrited) * 2:2] = scaled_data[1::2]
+                decode_tx_data(raw_data, buffer[writed * 2:(writed + rewrited) * 2], raw_format, from_complex64)
 
                 writed += rewrited
 
-            device.pybladerf_sync_tx(buffer, writed, None, 0)
-            transfer_status.byte_count.fetch_add(writed * bytes_per_sample)
-            transfer_status.stream_power.fetch_add(np.sum(buffer[:writed * 2].astype(np.int32) ** 2))
+            send_tx_data(device, transfer_status, stats, meta, buffer, writed, bytes_per_sample)
             continue
 
+    # the last partial buffer of a timestamped burst is flushed by its end
+    if meta is not None and meta.flags != pybladerf.PYBLADERF_META_FLAG_TX_BURST_START:
+        try:
+            buffer[:2] = 0
+            meta.flags = pybladerf.PYBLADERF_META_FLAG_TX_BURST_END
+            device.pybladerf_sync_tx(buffer, 1, meta, 0)
+        except Exception as ex:
+            sys.stderr.write(f'{ex}\n')
+
     close_ready.set()
 
 
+def format_signal_stats(signal_stats: dict) -> str:
+    return (f'average power {signal_stats["power_dbfs"]:.1f} dBfs, peak {signal_stats["peak_dbfs"]:.1f} dBfs, '
+            f'clipped {signal_stats["clipped_ratio"] * 100:.2f}%, DC I/Q {signal_stats["dc_i"]:+.4f}/{signal_stats["dc_q"]:+.4f}')
+
+
 def pybladerf_transfer(frequency: int | None = None, sample_rate: int = 10_000_000, baseband_filter_bandwidth: int | None = None,
                        gain: int = 0, channel: int = 0, oversample: bool = False, antenna_enable: bool = False,
                        repeat_tx: bool = False, synchronize: bool = False, num_samples: int | None = None, serial_number: str | None = None,
                        rx_filename: str | None = None, tx_filename: str | None = None, rx_buffer: object | None = None, tx_buffer: object | None = None,
-                       print_to_console: bool = True) -> None:
+                       print_to_console: bool = True, raw_format: bool = False, stats: pybladerf.pybladerf_iq_stats | None = None,
+                       compression: pybladerf.pybladerf_iq_codec | None = None, compression_bits: int = 8,
+                       tx_frequency: int | None = None, tx_gain: int | None = None, tx_stats: pybladerf.pybladerf_iq_stats | None = None,
+                       align_start: bool = False) -> None:
 
     global working_sdrs, sdr_ids
 
+    cdef c_bool rx_enabled = rx_buffer is not None or rx_filename is not None
+    cdef c_bool tx_enabled = tx_buffer is not None or tx_filename is not None
+    cdef c_bool full_duplex = rx_enabled and tx_enabled
+
+    if not rx_enabled and not tx_enabled:
+        raise RuntimeError('BladeRF transfer needs an RX file or buffer, a TX file or buffer, or both for full duplex.')
+
+    if num_samples and num_samples >= SAMPLES_TO_XFER_MAX:
+        raise RuntimeError(f'num_samples must be less than {SAMPLES_TO_XFER_MAX}')
+
+    if frequency is not None:
+        if rx_enabled and not FREQ_RX_MIN_HZ <= frequency <= FREQ_MAX_HZ:
+            raise RuntimeError(f'frequency for RX must be between {FREQ_RX_MIN_HZ} and {FREQ_MAX_HZ}')
+        if tx_enabled and tx_frequency is None and not FREQ_TX_MIN_HZ <= frequency <= FREQ_MAX_HZ:
+            raise RuntimeError(f'frequency for TX must be between {FREQ_TX_MIN_HZ} and {FREQ_MAX_HZ}')
+    else:
+        frequency = DEFAULT_FREQUENCY
+
+    if tx_frequency is None:
+        tx_frequency = frequency
+    elif not FREQ_TX_MIN_HZ <= tx_frequency <= FREQ_MAX_HZ:
+        raise RuntimeError(f'tx_frequency must be between {FREQ_TX_MIN_HZ} and {FREQ_MAX_HZ}')
+
+    if tx_gain is None:
+        tx_gain = gain
+
+    if align_start and not full_duplex:
+        raise RuntimeError('align_start needs both RX and TX (full duplex).')
+    if align_start and synchronize:
+        raise RuntimeError('align_start cannot wait for an external trigger, the start is already given by the timestamps.')
+
     cdef uint8_t device_id = init_signals()
     cdef c_pybladerf.PyBladerfDevice device
     cdef uint8_t formated_channel
+    cdef list channels = []
 
     if serial_number is None:
         device = pybladerf.pybladerf_open()
@@ -318,124 +446,216 @@ def pybladerf_transfer(frequency: int | None = None, sample_rate: int = 10_000_0
         baseband_filter_bandwidth = int(sample_rate * .75)
     baseband_filter_bandwidth = int(baseband_filter_bandwidth) if MIN_BASEBAND_FILTER_BANDWIDTHS <= int(baseband_filter_bandwidth) <= MAX_BASEBAND_FILTER_BANDWIDTHS else int(sample_rate * .75)
 
-    if num_samples and num_samples >= SAMPLES_TO_XFER_MAX:
-        raise RuntimeError(f'num_samples must be less than {SAMPLES_TO_XFER_MAX}')
-
-    if (rx_buffer is not None or rx_filename is not None) and (tx_buffer is not None or tx_filename is not None):
-        raise RuntimeError('BladeRF transfer cannot receive and send IQ samples at the same time.')
-
-    elif rx_buffer is not None or rx_filename is not None:
-        formated_channel = pybladerf.PYBLADERF_CHANNEL_RX(channel)
-    elif tx_buffer is not None or tx_filename is not None:
-        formated_channel = pybladerf.PYBLADERF_CHANNEL_TX(channel)
-
-    if frequency is not None:
-        if (rx_buffer is not None or rx_filename is not None) and frequency > FREQ_MAX_HZ or frequency < FREQ_RX_MIN_HZ:
-            raise RuntimeError(f'frequency for RX must be between {FREQ_RX_MIN_HZ} and {FREQ_MAX_HZ}')
-        if (tx_buffer is not None or tx_filename is not None) and frequency > FREQ_MAX_HZ or frequency < FREQ_TX_MIN_HZ:
-            raise RuntimeError(f'frequency for RX must be between {FREQ_TX_MIN_HZ} and {FREQ_MAX_HZ}')
-    else:
-        frequency = DEFAULT_FREQUENCY
+    # in full duplex both directions run at once, each with its own frequency, gain, buffers and thread
+    if rx_enabled:
+        channels.append(pybladerf.PYBLADERF_CHANNEL_RX(channel))
+    if tx_enabled:
+        channels.append(pybladerf.PYBLADERF_CHANNEL_TX(channel))
 
     if oversample:
         if print_to_console:
             sys.stderr.write(f'call pybladerf_enable_feature({pybladerf.pybladerf_feature.PYBLADERF_FEATURE_OVERSAMPLE}, True)\n')
         device.pybladerf_enable_feature(pybladerf.pybladerf_feature.PYBLADERF_FEATURE_OVERSAMPLE, True)
 
-    if print_to_console:
-        sys.stderr.write(f'call pybladerf_set_sample_rate({sample_rate / 1e6 :.3f} MHz)\n')
-    device.pybladerf_set_sample_rate(formated_channel, sample_rate)
-
-    if not oversample:
+    triggers = []
+    for formated_channel in channels:
         if print_to_console:
-            sys.stderr.write(f'call pybladerf_set_bandwidth({formated_channel}, {baseband_filter_bandwidth / 1e6 :.3f} MHz)\n')
-        device.pybladerf_set_bandwidth(formated_channel, baseband_filter_bandwidth)
+            sys.stderr.write(f'call pybladerf_set_sample_rate({sample_rate / 1e6 :.3f} MHz)\n')
+        device.pybladerf_set_sample_rate(formated_channel, sample_rate)
 
-    if print_to_console:
-        sys.stderr.write(f'call pybladerf_trigger_init({formated_channel}, {pybladerf.pybladerf_trigger_signal.PYBLADERF_TRIGGER_MINI_EXP_1})\n')
-    trigger = device.pybladerf_trigger_init(formated_channel, pybladerf.pybladerf_trigger_signal.PYBLADERF_TRIGGER_MINI_EXP_1)
+        if not oversample:
+            if print_to_console:
+                sys.stderr.write(f'call pybladerf_set_bandwidth({formated_channel}, {baseband_filter_bandwidth / 1e6 :.3f} MHz)\n')
+            device.pybladerf_set_bandwidth(formated_channel, baseband_filter_bandwidth)
 
-    if synchronize:
         if print_to_console:
-            sys.stderr.write(f'set trigger role as {pybladerf.pybladerf_trigger_role.PYBLADERF_TRIGGER_ROLE_SLAVE}')
-        trigger.role = pybladerf.pybladerf_trigger_role.PYBLADERF_TRIGGER_ROLE_SLAVE
-    else:
-        if print_to_console:
-            sys.stderr.write(f'set trigger role as {pybladerf.pybladerf_trigger_role.PYBLADERF_TRIGGER_ROLE_MASTER}')
-        trigger.role = pybladerf.pybladerf_trigger_role.PYBLADERF_TRIGGER_ROLE_MASTER
+            sys.stderr.write(f'call pybladerf_trigger_init({formated_channel}, {pybladerf.pybladerf_trigger_signal.PYBLADERF_TRIGGER_MINI_EXP_1})\n')
+        trigger = device.pybladerf_trigger_init(formated_channel, pybladerf.pybladerf_trigger_signal.PYBLADERF_TRIGGER_MINI_EXP_1)
 
-    if print_to_console:
-        sys.stderr.write(f'call pybladerf_trigger_arm(trigger, True)\n')
-    device.pybladerf_trigger_arm(trigger, True)
+        # in full duplex TX is a slave of the RX trigger, so both directions start on the same edge
+        if synchronize or triggers:
+            if print_to_console:
+                sys.stderr.write(f'set trigger role as {pybladerf.pybladerf_trigger_role.PYBLADERF_TRIGGER_ROLE_SLAVE}')
+            trigger.role = pybladerf.pybladerf_trigger_role.PYBLADERF_TRIGGER_ROLE_SLAVE
+        else:
+            if print_to_console:
+                sys.stderr.write(f'set trigger role as {pybladerf.pybladerf_trigger_role.PYBLADERF_TRIGGER_ROLE_MASTER}')
+            trigger.role = pybladerf.pybladerf_trigger_role.PYBLADERF_TRIGGER_ROLE_MASTER
 
-    if print_to_console:
-        sys.stderr.write(f'call pybladerf_set_frequency({formated_channel}, {frequency} Hz / {frequency / 1e6 :.3f} MHz)\n')
-    device.pybladerf_set_frequency(formated_channel, frequency)
+        if print_to_console:
+            sys.stderr.write(f'call pybladerf_trigger_arm(trigger, True)\n')
+        device.pybladerf_trigger_arm(trigger, True)
+        triggers.append(trigger)
 
-    if print_to_console:
-        sys.stderr.write(f'call pybladerf_set_gain_mode({formated_channel}, {pybladerf.pybladerf_gain_mode.PYBLADERF_GAIN_MGC})\n')
-    device.pybladerf_set_gain_mode(formated_channel, pybladerf.pybladerf_gain_mode.PYBLADERF_GAIN_MGC)
-    device.pybladerf_set_gain(formated_channel, gain)
+        channel_frequency = tx_frequency if pybladerf.PYBLADERF_CHANNEL_IS_TX(formated_channel) else frequency
+        if print_to_console:
+            sys.stderr.write(f'call pybladerf_set_frequency({formated_channel}, {channel_frequency} Hz / {channel_frequency / 1e6 :.3f} MHz)\n')
+        device.pybladerf_set_frequency(formated_channel, channel_frequency)
 
-    if antenna_enable:
         if print_to_console:
-            sys.stderr.write(f'call pybladerf_set_bias_tee({formated_channel}, True)\n')
-        device.pybladerf_set_bias_tee(formated_channel, True)
+            sys.stderr.write(f'call pybladerf_set_gain_mode({formated_channel}, {pybladerf.pybladerf_gain_mode.PYBLADERF_GAIN_MGC})\n')
+        device.pybladerf_set_gain_mode(formated_channel, pybladerf.pybladerf_gain_mode.PYBLADERF_GAIN_MGC)
+        device.pybladerf_set_gain(formated_channel, tx_gain if pybladerf.PYBLADERF_CHANNEL_IS_TX(formated_channel) else gain)
 
-    rx_file = open(rx_filename, 'wb') if rx_filename not in ('-', None) else (sys.stdout.buffer if rx_filename == '-' else None)
-    tx_file = open(tx_filename, 'rb') if tx_filename not in ('-', None) else (sys.stdin.buffer if tx_filename == '-' else None)
-    close_ready = threading.Event()
+        if antenna_enable:
+            if print_to_console:
+                sys.stderr.write(f'call pybladerf_set_bias_tee({formated_channel}, True)\n')
+            device.pybladerf_set_bias_tee(formated_channel, True)
+
+    # compressed recordings are raw recordings coded in independent blocks
+    raw_format = raw_format or compression is not None
+    cdef c_bool raw_rx = raw_format and rx_buffer is None and rx_filename is not None
+    cdef c_bool raw_tx = raw_format and tx_buffer is None and tx_filename is not None
+    cdef c_bool compressed_rx = raw_rx and compression is not None
+    cdef c_bool compressed_tx = raw_tx and tx_filename != '-' and is_compressed_file(tx_filename)
+    cdef str data_format = 'SC8_Q7' if oversample else 'SC16_Q11'
+
+    if raw_tx and tx_filename != '-':
+        if compressed_tx:
+            tx_file = CompressedFileReader(tx_filename, int(os.environ.get('pybladerf_transfer_compression_workers', 0)) or None)
+            tx_format = tx_file.data_format
+        else:
+            raw_header = read_raw_header(tx_filename)
+            tx_format = raw_header.get('format') if raw_header is not None else data_format
+        if tx_format != data_format:
+            if compressed_tx:
+                tx_file.close()
+            raise RuntimeError(f'{tx_filename} holds {tx_format} samples, but {data_format} is used {"with" if oversample else "without"} oversample')
+
+    if compressed_rx:
+        rx_file = CompressedFileWriter(
+            rx_filename if rx_filename != '-' else sys.stdout.buffer,
+            data_format,
+            sample_rate,
+            frequency,
+            compression,
+            compression_bits,
+            int(os.environ.get('pybladerf_transfer_samples_per_transfer', 65536)),
+            int(os.environ.get('pybladerf_transfer_compression_workers', 0)) or None,
+        )
+        if print_to_console:
+            sys.stderr.write(f'Recording {data_format} compressed with {pybladerf.pybladerf_iq_codec(compression).name}{f" ({compression_bits} bits)" if compression == pybladerf.pybladerf_iq_codec.PYBLADERF_IQ_CODEC_BFP else ""}\n')
+    elif raw_rx:
+        rx_file = RawFileWriter(
+            rx_filename if rx_filename != '-' else sys.stdout.buffer,
+            int(os.environ.get('pybladerf_transfer_raw_block_size', 4 * 1024 * 1024)),
+            os.environ.get('pybladerf_transfer_direct_io', '0') == '1',
+        )
+        if print_to_console:
+            sys.stderr.write(f'Recording raw {data_format} in {rx_file.block_size // 1024} KiB blocks{" with O_DIRECT" if rx_file.direct else ""}\n')
+    else:
+        rx_file = open(rx_filename, 'wb') if rx_filename not in ('-', None) else (sys.stdout.buffer if rx_filename == '-' else None)
+    if not compressed_tx:
+        tx_file = open(tx_filename, 'rb') if tx_filename not in ('-', None) else (sys.stdin.buffer if tx_filename == '-' else None)
+    cdef double record_start = 0
+    rx_close_ready = threading.Event()
+    tx_close_ready = threading.Event()
+
+    cdef TransferStatus rx_status
+    cdef TransferStatus tx_status
+    reset_transfer_status(&rx_status)
+    reset_transfer_status(&tx_status)
+
+    # the report resets only statistics it owns, a caller polling its own object sees them accumulate
+    cdef c_bool own_stats = stats is None
+    cdef c_bool own_tx_stats = tx_stats is None or not full_duplex
+    if own_stats:
+        stats = pybladerf.pybladerf_iq_stats(oversample)
+    if own_tx_stats:
+        tx_stats = pybladerf.pybladerf_iq_stats(oversample) if full_duplex else stats
+
+    # full duplex streams timestamped samples: overruns and underruns become visible and both directions can start at a known sample
+    if full_duplex:
+        stream_format = pybladerf.pybladerf_format.PYBLADERF_FORMAT_SC8_Q7_META if oversample else pybladerf.pybladerf_format.PYBLADERF_FORMAT_SC16_Q11_META
+    else:
+        stream_format = pybladerf.pybladerf_format.PYBLADERF_FORMAT_SC8_Q7 if oversample else pybladerf.pybladerf_format.PYBLADERF_FORMAT_SC16_Q11
 
-    cdef TransferStatus transfer_status
-    if rx_buffer is not None or rx_filename is not None:
+    for formated_channel in channels:
         device.pybladerf_sync_config(
-            layout=pybladerf.pybladerf_channel_layout.PYBLADERF_RX_X1,
-            data_format=pybladerf.pybladerf_format.PYBLADERF_FORMAT_SC8_Q7 if oversample else pybladerf.pybladerf_format.PYBLADERF_FORMAT_SC16_Q11,
+            layout=pybladerf.pybladerf_channel_layout.PYBLADERF_TX_X1 if pybladerf.PYBLADERF_CHANNEL_IS_TX(formated_channel) else pybladerf.pybladerf_channel_layout.PYBLADERF_RX_X1,
+            data_format=stream_format,
             num_buffers=int(os.environ.get('pybladerf_transfer_num_buffers', 4096)),
             buffer_size=int(os.environ.get('pybladerf_transfer_buffer_size', 8192)),
             num_transfers=int(os.environ.get('pybladerf_transfer_num_transfers', 64)),
             stream_timeout=0,
         )
+    for formated_channel in channels:
+        device.pybladerf_enable_module(formated_channel, True)
+
+    cdef c_pybladerf.pybladerf_metadata rx_meta = None
+    cdef c_pybladerf.pybladerf_metadata tx_meta = None
+    cdef uint64_t rx_timestamp = 0
+    cdef uint64_t tx_timestamp = 0
+    cdef uint64_t start_lead = 0
+    cdef int64_t tx_offset = 0
+    cdef uint64_t align_uncertainty = 0
+    cdef dict rx_header = {'channel': channel, 'gain': gain}
+
+    if full_duplex:
+        # TX always starts a little ahead of its clock. RX and TX count separately, with align_start their offset is measured over USB
+        # and both start at the same instant to within the measurement uncertainty
+        start_lead = int(sample_rate * float(os.environ.get('pybladerf_transfer_start_lead', 50)) / 1000)
+        if align_start:
+            tx_offset, align_uncertainty = measure_tx_offset(device, int(os.environ.get('pybladerf_transfer_align_rounds', 8)))
+            rx_timestamp = device.pybladerf_get_timestamp(pybladerf.pybladerf_direction.PYBLADERF_RX) + start_lead
+            tx_timestamp = rx_timestamp + tx_offset
+        else:
+            tx_timestamp = device.pybladerf_get_timestamp(pybladerf.pybladerf_direction.PYBLADERF_TX) + start_lead
+
+        rx_meta = pybladerf.pybladerf_metadata(rx_timestamp if align_start else 0, 0 if align_start else pybladerf.PYBLADERF_META_FLAG_RX_NOW, 0, 0)
+        tx_meta = pybladerf.pybladerf_metadata(tx_timestamp, pybladerf.PYBLADERF_META_FLAG_TX_BURST_START, 0, 0)
+        tx_status.next_timestamp = tx_timestamp
+        tx_status.resync_lead = start_lead
+        tx_status.check_interval = int(sample_rate * float(os.environ.get('pybladerf_transfer_underrun_check_interval', 100)) / 1000)
 
-        processing_thread = threading.Thread(target=rx_process, args=(
+        if align_start:
+            rx_header.update(rx_device_timestamp=rx_timestamp, tx_device_timestamp=tx_timestamp, align_uncertainty=align_uncertainty, tx_frequency=tx_frequency)
+            if print_to_console:
+                sys.stderr.write(f'Full duplex, RX starts at timestamp {rx_timestamp}, TX at {tx_timestamp} (aligned to ±{align_uncertainty} samples)\n')
+        elif print_to_console:
+            sys.stderr.write(f'Full duplex, TX starts at timestamp {tx_timestamp}\n')
+
+    if rx_enabled:
+        rx_thread = threading.Thread(target=rx_process, args=(
             device,
             device_id,
-            <uintptr_t> &transfer_status,
-            formated_channel,
+            <uintptr_t> &rx_status,
+            stats,
             1 if oversample else 0,
-            close_ready,
+            1 if raw_rx else 0,
+            rx_close_ready,
             rx_buffer,
             rx_file,
-            num_samples if num_samples else -1
+            num_samples if num_samples else -1,
+            rx_meta,
         ), daemon=True)
-        processing_thread.start()
 
-    elif tx_buffer is not None or tx_filename is not None:
-        device.pybladerf_sync_config(
-            layout=pybladerf.pybladerf_channel_layout.PYBLADERF_TX_X1,
-            data_format=pybladerf.pybladerf_format.PYBLADERF_FORMAT_SC8_Q7 if oversample else pybladerf.pybladerf_format.PYBLADERF_FORMAT_SC16_Q11,
-            num_buffers=int(os.environ.get('pybladerf_transfer_num_buffers', 4096)),
-            buffer_size=int(os.environ.get('pybladerf_transfer_buffer_size', 8192)),
-            num_transfers=int(os.environ.get('pybladerf_transfer_num_transfers', 64)),
-            stream_timeout=0,
-        )
+        record_start = time.time()
+        if compressed_rx:
+            rx_file.start_timestamp = record_start
+        elif raw_rx and rx_filename != '-':
+            write_raw_header(rx_filename, data_format, sample_rate, frequency, record_start, **rx_header)
+        rx_thread.start()
 
-        processing_thread = threading.Thread(target=tx_process, args=(
+    if tx_enabled:
+        tx_thread = threading.Thread(target=tx_process, args=(
             device,
             device_id,
-            <uintptr_t> &transfer_status,
-            formated_channel,
+            <uintptr_t> &tx_status,
+            tx_stats,
             1 if oversample else 0,
             1 if repeat_tx else 0,
-            close_ready,
+            1 if raw_tx else 0,
+            tx_close_ready,
             tx_buffer,
             tx_file,
-            num_samples if num_samples else -1
+            num_samples if num_samples else -1,
+            tx_meta,
         ), daemon=True)
-        processing_thread.start()
+        tx_thread.start()
 
     if not synchronize:
-        device.pybladerf_trigger_fire(trigger)
+        device.pybladerf_trigger_fire(triggers[0])
 
     if num_samples and print_to_console:
         sys.stderr.write(f'samples_to_xfer {num_samples}/{num_samples / (5e5 if oversample else 25e4):.3f} MB\n')
@@ -443,31 +663,33 @@ def pybladerf_transfer(frequency: int | None = None, sample_rate: int = 10_000_0
     cdef double time_start = time.time()
     cdef double time_prev = time.time()
     cdef double time_difference = 0
-    cdef uint64_t stream_power = 0
-    cdef double dB_full_scale = 0
     cdef uint64_t byte_count = 0
+    cdef uint64_t rx_byte_count = 0
+    cdef uint64_t tx_byte_count = 0
     cdef double time_now = 0
 
-    cdef uint16_t max_scale = 127 if oversample else 2047
-
     while working_sdrs[device_id].load():
         time.sleep(0.05)
         time_now = time.time()
         time_difference = time_now - time_prev
         if time_difference >= 1.0:
             if print_to_console:
-                byte_count = transfer_status.byte_count.load()
-                stream_power = transfer_status.stream_power.load()
+                rx_byte_count = rx_status.byte_count.load()
+                tx_byte_count = tx_status.byte_count.load()
+                byte_count = rx_byte_count + tx_byte_count
 
-                transfer_status.byte_count.store(0)
-                transfer_status.stream_power.store(0)
+                rx_status.byte_count.store(0)
+                tx_status.byte_count.store(0)
 
                 if byte_count == 0 and synchronize:
                     sys.stderr.write("Waiting for trigger...\n")
-                elif byte_count != 0 and not transfer_status.tx_complete:
-                    dB_full_scale = 10 * np.log10(stream_power / ((byte_count / 2) * max_scale ** 2))
-                    sys.stderr.write(f'{(byte_count / time_difference) / 1e6:.1f} MB/second, average power {dB_full_scale:.1f} dBfs\n')
-                elif byte_count == 0 and not synchronize and not transfer_status.tx_complete:
+                elif byte_count != 0 and not tx_status.tx_complete:
+                    if full_duplex:
+                        sys.stderr.write(f'RX {(rx_byte_count / time_difference) / 1e6:.1f} MB/second, overruns {rx_status.xrun_count.load()} ({rx_status.xrun_samples.load()} samples), {format_signal_stats(stats.snapshot(own_stats))}\n'
+                                         f'TX {(tx_byte_count / time_difference) / 1e6:.1f} MB/second, underruns {tx_status.xrun_count.load()} ({tx_status.xrun_samples.load()} samples), {format_signal_stats(tx_stats.snapshot(own_tx_stats))}\n')
+                    else:
+                        sys.stderr.write(f'{(byte_count / time_difference) / 1e6:.1f} MB/second, {format_signal_stats(stats.snapshot(own_stats))}\n')
+                elif byte_count == 0 and not synchronize and not tx_status.tx_complete:
                     if print_to_console:
                         sys.stderr.write('Couldn\'t transfer any data for one second.\n')
                     break
@@ -482,31 +704,46 @@ def pybladerf_transfer(frequency: int | None = None, sample_rate: int = 10_000_0
             sys.stderr.write('\nExiting... [ pybladerf streaming stopped ]\n')
 
     working_sdrs[device_id].store(0)
-    close_ready.wait()
+    if rx_enabled:
+        rx_close_ready.wait()
+    if tx_enabled:
+        tx_close_ready.wait()
     sdr_ids.pop(device.serialno, None)
 
-    trigger.role = pybladerf.pybladerf_trigger_role.PYBLADERF_TRIGGER_ROLE_DISABLED
-    device.pybladerf_trigger_arm(trigger, False)
+    for trigger in triggers:
+        trigger.role = pybladerf.pybladerf_trigger_role.PYBLADERF_TRIGGER_ROLE_DISABLED
+        device.pybladerf_trigger_arm(trigger, False)
 
     if print_to_console:
         sys.stderr.write(f'Total time: {time_now - time_start:.5f} seconds\n')
+        if full_duplex:
+            sys.stderr.write(f'RX overruns {rx_status.xrun_count.load()} ({rx_status.xrun_samples.load()} samples), TX underruns {tx_status.xrun_count.load()} ({tx_status.xrun_samples.load()} samples)\n')
 
-    if rx_filename not in ('-', None):
+    if compressed_rx:
+        rx_file.close()
+        if print_to_console and rx_file.num_samples:
+            sys.stderr.write(f'Compressed {rx_file.num_samples} samples to {rx_file.bytes_written / (rx_file.num_samples * (2 if oversample else 4)) * 100:.1f}%\n')
+    elif raw_rx:
+        rx_file.close()
+        if rx_filename != '-':
+            write_raw_header(rx_filename, data_format, sample_rate, frequency, record_start, rx_file.bytes_written // (2 if oversample else 4), **rx_header)
+    elif rx_filename not in ('-', None):
         rx_file.close()
 
     if tx_filename not in ('-', None):
         tx_file.close()
 
-    if antenna_enable:
+    for formated_channel in channels:
+        if antenna_enable:
+            try:
+                device.pybladerf_set_bias_tee(formated_channel, False)
+            except Exception as ex:
+                    sys.stderr.write(f'{ex}\n')
+
         try:
-            device.pybladerf_set_bias_tee(formated_channel, False)
+            device.pybladerf_enable_module(formated_channel, False)
         except Exception as ex:
                 sys.stderr.write(f'{ex}\n')
-
-    try:
-        device.pybladerf_enable_module(formated_channel, False)
-    except Exception as ex:
-            sys.stderr.write(f'{ex}\n')
     try:
         device.pybladerf_close()
         if print_to_console:
@@ -22,9 +22,12 @@
 
 import atexit
 import io
+import json
+import mmap
 import os
 import sys
 import time
+from datetime import datetime, timezone
 from queue import Queue
 from tempfile import NamedTemporaryFile
 from threading import Event, RLock, Thread
@@ -32,31 +35,54 @@ from typing import Any
 
 import numpy as np
 
+from python_bladerf.pylibbladerf import pybladerf
+
+
+RING_POLL_INTERVAL = 0.0005  # seconds
+
 
 class FileBuffer:
     '''
     A file-based buffer designed for efficient data transmission and reception, minimizing RAM usage.
     Provides methods for appending data, retrieving new data, accessing the entire buffer, and processing data in chunks.
     Supports ring-buffer behavior.
+
+    With `capacity` (in elements) the buffer is a fixed-size ring in a memory-mapped file for one writer and one reader.
+    Neither side takes a lock: append() waits while the ring is full and reads return zero-copy views (a copy only when a chunk
+    crosses the end of the file). A returned view stays valid until the next read, which releases it to the writer.
+    get_chunk(ring=True) keeps everything it read so it can be replayed, so a repeated playlist must fit into the capacity;
+    append() raises ValueError for data that can never fit while such a reader holds the ring.
     '''
-    def __init__(self, dtype: type = np.complex64, use_thread: bool = False) -> None:
+    def __init__(self, dtype: type = np.complex64, use_thread: bool = False, capacity: int | None = None) -> None:
         self._use_thread = use_thread
         self._dtype = dtype
+        self._run_available = True
 
         self._read_ptr = 0
         self._write_ptr = 0
 
         self._dtype_size = np.dtype(dtype).itemsize
+        self._capacity = int(capacity) if capacity else 0
 
         self._temp_file = NamedTemporaryFile(mode='r+b', delete=True)
-        self._writer = io.FileIO(self._temp_file.name, mode='w')
-        self._reader = io.FileIO(self._temp_file.name, mode='r')
+        if self._capacity:
+            # counters only grow, the writer owns _write_count and the reader _read_count/_release_count;
+            # single attribute loads and stores are atomic, so the sides only ever read each other's counter
+            self._temp_file.truncate(self._capacity * self._dtype_size)
+            self._mmap = mmap.mmap(self._temp_file.fileno(), self._capacity * self._dtype_size)
+            self._data: np.ndarray[Any, Any] = np.frombuffer(self._mmap, dtype=dtype)
+            self._write_count = 0
+            self._read_count = 0
+            self._release_count = 0
+            self._replaying = False
+        else:
+            self._writer = io.FileIO(self._temp_file.name, mode='w')
+            self._reader = io.FileIO(self._temp_file.name, mode='r')
         self._not_empty = Event()
         self._rlock = RLock()
         self._wlock = RLock()
 
         if use_thread:
-            self._run_available = True
             self._queue = Queue()  # type: ignore
             self._append_thread = Thread(target=self._append, daemon=True)
             self._append_thread.start()
@@ -67,6 +93,9 @@ class FileBuffer:
         self._cleanup()
 
     def __getitem__(self, index: int | slice) -> Any:
+        if self._capacity:
+            return self._ring_getitem(index)
+
         with self._rlock:
 
             write_ptr = self._write_ptr
@@ -108,8 +137,11 @@ class FileBuffer:
             try:
                 with self._wlock:
                     with self._rlock:
-                        self._reader.close()
-                        self._writer.close()
+                        if self._capacity:
+                            self._close_mmap()
+                        else:
+                            self._reader.close()
+                            self._writer.close()
                         self._temp_file.close()
 
             except Exception as er:
@@ -127,6 +159,10 @@ class FileBuffer:
                 data, chunk_size = self._queue.get_nowait()
 
                 data = data.astype(self._dtype, copy=False)
+                if self._capacity:
+                    self._ring_write(data)
+                    continue
+
                 chunk_elements = chunk_size // self._dtype_size
 
                 with self._wlock:
@@ -146,8 +182,12 @@ class FileBuffer:
     def append(self, data: np.ndarray[Any, Any], chunk_size: int = 131072) -> None:
         if len(data) == 0:
             return
+        if self._capacity and self._replaying and self._write_count - self._release_count + len(data) > self._capacity:
+            raise ValueError('append() failed: data does not fit into the capacity of a replayed ring')
         if self._use_thread:
             self._queue.put_nowait((data, chunk_size))
+        elif self._capacity:
+            self._ring_write(data.astype(self._dtype, copy=False))
         else:
             data = data.astype(self._dtype, copy=False)
             chunk_elements = chunk_size // self._dtype_size
@@ -165,6 +205,12 @@ class FileBuffer:
                         break
 
     def get_all(self, use_memmap: bool = False, wait: bool = False, timeout: float | None = None) -> np.ndarray[Any, Any]:
+        if self._capacity:
+            if self._ring_wait(True, timeout, True) is None:
+                return np.array([], dtype=self._dtype)
+            write_count = self._write_count
+            return self._ring_view(self._release_count, write_count - self._release_count)
+
         with self._rlock:
 
             if self._write_ptr == 0:
@@ -181,6 +227,18 @@ class FileBuffer:
             return np.memmap(self._temp_file, dtype=self._dtype)
 
     def get_new(self, wait: bool = False, timeout: float | None = None) -> np.ndarray[Any, Any]:
+        if self._capacity:
+            read_count = self._read_count
+            self._release_count = read_count
+            self._replaying = False
+            write_count = self._ring_wait(wait, timeout, False)
+            if write_count is None:
+                return np.array([], dtype=self._dtype)
+
+            result = self._ring_view(read_count, write_count - read_count)
+            self._read_count = write_count
+            return result
+
         with self._rlock:
 
             write_ptr = self._write_ptr
@@ -199,6 +257,9 @@ class FileBuffer:
             return result
 
     def get_chunk(self, num_elements: int, ring: bool = True, wait: bool = False, timeout: float | None = None) -> np.ndarray[Any, Any]:
+        if self._capacity:
+            return self._ring_get_chunk(num_elements, ring, wait, timeout)
+
         with self._rlock:
 
             if num_elements <= 0:
@@ -248,15 +309,25 @@ class FileBuffer:
             return result
 
     def empty(self) -> bool:
+        if self._capacity:
+            return self._write_count == 0
         return self._write_ptr == 0
 
     def has_new_data(self) -> bool:
+        if self._capacity:
+            return self._read_count < self._write_count
         return self._read_ptr < self._write_ptr
 
     def size(self) -> int:
+        if self._capacity:
+            return self._write_count
         return self._write_ptr // self._dtype_size
 
     def rewind(self) -> None:
+        if self._capacity:
+            self._read_count = self._release_count
+            return
+
         with self._rlock:
             self._reader.seek(0)
             self._read_ptr = 0
@@ -267,14 +338,1177 @@ class FileBuffer:
 
         with self._wlock:
             with self._rlock:
-                os.truncate(self._temp_file.fileno(), 0)
-                self._reader.seek(0)
-                self._writer.seek(0)
-                self._write_ptr = 0
-                self._read_ptr = 0
+                if self._capacity:
+                    self._write_count = 0
+                    self._read_count = 0
+                    self._release_count = 0
+                    self._replaying = False
+                else:
+                    os.truncate(self._temp_file.fileno(), 0)
+                    self._reader.seek(0)
+                    self._writer.seek(0)
+                    self._write_ptr = 0
+                    self._read_ptr = 0
 
         if self._use_thread:
             self._run_available = True
             self._queue = Queue()
             self._append_thread = Thread(target=self._append, daemon=True)
             self._append_thread.start()
+
+    @property
+    def capacity(self) -> int:
+        return self._capacity
+
+    def _close_mmap(self) -> None:
+        self.__dict__.pop('_data', None)
+        try:
+            self._mmap.close()
+        except BufferError:
+            # views handed out are still alive, the mapping goes away with them
+            pass
+
+    def _ring_write(self, data: np.ndarray[Any, Any]) -> None:
+        written = 0
+        while written < len(data):
+            write_count = self._write_count
+            space = self._capacity - (write_count - self._release_count)
+            if space <= 0:
+                # a replaying reader never releases, the rest of the playlist would block forever
+                if self._replaying:
+                    raise ValueError('append() failed: data does not fit into the capacity of a replayed ring')
+                if not self._run_available:
+                    return
+                time.sleep(RING_POLL_INTERVAL)
+                continue
+
+            start = write_count % self._capacity
+            count = min(len(data) - written, space, self._capacity - start)
+            self._data[start:start + count] = data[written:written + count]
+            written += count
+            self._write_count = write_count + count
+
+    def _ring_wait(self, wait: bool, timeout: float | None, replay: bool) -> int | None:
+        deadline = None if timeout is None else time.monotonic() + timeout
+        while True:
+            write_count = self._write_count
+            if write_count > self._read_count or (replay and write_count > self._release_count):
+                return write_count
+            if not wait or (deadline is not None and time.monotonic() >= deadline):
+                return None
+            time.sleep(RING_POLL_INTERVAL)
+
+    def _ring_view(self, start: int, count: int) -> np.ndarray[Any, Any]:
+        begin = start % self._capacity
+        if begin + count <= self._capacity:
+            return self._data[begin:begin + count]
+        return np.concatenate((self._data[begin:], self._data[:begin + count - self._capacity]))
+
+    def _ring_get_chunk(self, num_elements: int, ring: bool, wait: bool, timeout: float | None) -> np.ndarray[Any, Any]:
+        if num_elements <= 0:
+            return np.array([], dtype=self._dtype)
+
+        read_count = self._read_count
+        if not ring:
+            self._release_count = read_count
+        self._replaying = ring
+
+        write_count = self._ring_wait(wait, timeout, ring)
+        if write_count is None:
+            return np.array([], dtype=self._dtype)
+
+        available = write_count - read_count
+        if available >= num_elements or not ring:
+            count = min(available, num_elements)
+            result = self._ring_view(read_count, count)
+            self._read_count = read_count + count
+            return result
+
+        # replay from the oldest kept element until the chunk is full
+        result = np.empty(num_elements, dtype=self._dtype)
+        filled = 0
+        while filled < num_elements:
+            if available <= 0:
+                read_count = self._release_count
+                available = write_count - read_count
+            count = min(num_elements - filled, available)
+            result[filled:filled + count] = self._ring_view(read_count, count)
+            filled += count
+            available -= count
+            read_count += count
+
+        self._read_count = read_count
+        return result
+
+    def _ring_getitem(self, index: int | slice) -> Any:
+        if self._ring_wait(True, None, True) is None:
+            raise IndexError('index out of range')
+
+        first, size = self._release_count, self._write_count
+        if isinstance(index, int):
+            index = index + size if index < 0 else index
+            if index < first or index >= size:
+                raise IndexError('index out of range')
+            return self._data[index % self._capacity]
+
+        if isinstance(index, slice):
+            start, stop, step = index.indices(size)
+            if start < first or stop < start:
+                raise IndexError('slice out of range')
+            return self._ring_view(start, stop - start)[::step]
+
+        raise TypeError('index must be int or slice')
+
+
+WATERFALL_MAGIC = b'PBRFWF01'
+WATERFALL_VERSION = 1
+WATERFALL_HEADER_SIZE = 4096
+WATERFALL_HEADER_DTYPE = np.dtype([
+    ('magic', 'S8'),
+    ('version', '<u4'),
+    ('header_size', '<u4'),
+    ('num_rows', '<u8'),
+    ('num_bins', '<u8'),
+    ('fft_size', '<u4'),
+    ('sweep_style', '<u4'),
+    ('sample_rate', '<u8'),
+    ('bin_width', '<f8'),
+    ('frequencies_offset', '<u8'),
+    ('timestamps_offset', '<u8'),
+    ('data_offset', '<u8'),
+    ('write_row', '<u8'),
+    ('rows_written', '<u8'),
+])
+
+
+def _waterfall_layout(num_rows: int, num_bins: int) -> tuple[int, int, int, int]:
+    frequencies_offset = WATERFALL_HEADER_SIZE
+    timestamps_offset = frequencies_offset + num_bins * 8
+    page_size = max(mmap.ALLOCATIONGRANULARITY, 4096)
+    data_offset = -(-(timestamps_offset + num_rows * 8) // page_size) * page_size
+    return frequencies_offset, timestamps_offset, data_offset, data_offset + num_rows * num_bins * 4
+
+
+class WaterfallStore:
+    '''
+    A memory-mapped time x frequency float32 matrix file that pybladerf_sweep writes one full sweep per row into.
+    The file starts with a 4096 byte header (WATERFALL_HEADER_DTYPE), followed by the float64 frequency axis, the uint64 per-row timestamps
+    (microseconds since the epoch) and the page-aligned float32 rows. Rows are used as a ring, `write_row` is the row being filled and
+    `rows_written` counts completed rows. Bins of hops that were not received in a sweep are NaN.
+    Other processes can open the file with WaterfallReader or np.memmap while the sweep runs.
+    '''
+    def __init__(self, filename: str, num_rows: int, segments: list[tuple[int, int, int]], fft_size: int, sample_rate: int, sweep_style: int, hop_frequencies: list[int]) -> None:
+        '''
+        `segments` lists (start_frequency, stop_frequency, num_bins) of every spectrum slice a sweep produces, the row is laid out in frequency order.
+        `hop_frequencies` is the order the sweep visits its hops in, a hop that does not come after the previous one starts a new row.
+        '''
+        if num_rows <= 0:
+            raise ValueError('num_rows should be at least 1')
+
+        self._columns: dict[int, int] = {}
+        frequencies = []
+        for start_frequency, stop_frequency, num_bins in sorted(set(segments)):
+            if start_frequency in self._columns:
+                continue
+            self._columns[start_frequency] = len(frequencies)
+            frequencies.extend(start_frequency + i * (stop_frequency - start_frequency) / num_bins for i in range(num_bins))
+
+        self._num_rows = num_rows
+        self._num_bins = len(frequencies)
+        frequencies_offset, timestamps_offset, data_offset, file_size = _waterfall_layout(num_rows, self._num_bins)
+
+        with open(filename, 'w+b') as file:
+            file.truncate(file_size)
+
+        self._header = np.memmap(filename, dtype=WATERFALL_HEADER_DTYPE, mode='r+', offset=0, shape=(1,))
+        self._frequencies = np.memmap(filename, dtype='<f8', mode='r+', offset=frequencies_offset, shape=(self._num_bins,))
+        self._timestamps = np.memmap(filename, dtype='<u8', mode='r+', offset=timestamps_offset, shape=(num_rows,))
+        self._data = np.memmap(filename, dtype='<f4', mode='r+', offset=data_offset, shape=(num_rows, self._num_bins))
+
+        self._frequencies[:] = frequencies
+        header = self._header[0]
+        header['magic'] = WATERFALL_MAGIC
+        header['version'] = WATERFALL_VERSION
+        header['header_size'] = WATERFALL_HEADER_SIZE
+        header['num_rows'] = num_rows
+        header['num_bins'] = self._num_bins
+        header['fft_size'] = fft_size
+        header['sweep_style'] = sweep_style
+        header['sample_rate'] = sample_rate
+        header['bin_width'] = sample_rate / fft_size
+        header['frequencies_offset'] = frequencies_offset
+        header['timestamps_offset'] = timestamps_offset
+        header['data_offset'] = data_offset
+        header['write_row'] = 0
+        header['rows_written'] = 0
+
+        self._row = 0
+        self._rows_written = 0
+        self._row_timestamp = 0
+        self._row_started = False
+        self._hop_index = {frequency: i for i, frequency in enumerate(hop_frequencies)}
+        self._last_hop_index = -1
+
+    @property
+    def num_rows(self) -> int:
+        return self._num_rows
+
+    @property
+    def num_bins(self) -> int:
+        return self._num_bins
+
+    def write(self, time_str: str, hop_frequency: int, segments: list[tuple[int, np.ndarray[Any, Any]]]) -> None:
+        '''
+        Places the spectrum slices of one hop into the current row. A hop at or before the previous one in the sweep order completes
+        the previous row, so a dropped hop leaves NaN bins instead of merging two sweeps.
+        '''
+        hop_index = self._hop_index.get(hop_frequency)
+        if hop_index is None:
+            return
+
+        if hop_index <= self._last_hop_index and self._row_started:
+            self._commit_row()
+        self._last_hop_index = hop_index
+
+        if not self._row_started:
+            self._data[self._row].fill(np.nan)
+            self._row_timestamp = int(datetime.strptime(time_str, '%Y-%m-%d, %H:%M:%S.%f').timestamp() * 1e6)
+            self._row_started = True
+
+        row = self._data[self._row]
+        for start_frequency, bins in segments:
+            column = self._columns.get(start_frequency)
+            if column is not None:
+                row[column:column + len(bins)] = bins
+
+    def _commit_row(self) -> None:
+        self._timestamps[self._row] = self._row_timestamp
+        self._row = (self._row + 1) % self._num_rows
+        self._rows_written += 1
+
+        header = self._header[0]
+        header['write_row'] = self._row
+        header['rows_written'] = self._rows_written
+        self._row_started = False
+
+    def close(self) -> None:
+        if self._row_started:
+            self._commit_row()
+
+        self._data.flush()
+        self._timestamps.flush()
+        self._header.flush()
+
+
+class WaterfallReader:
+    '''
+    Read-only view of a WaterfallStore file, safe to use while pybladerf_sweep is still writing it.
+    '''
+    def __init__(self, filename: str) -> None:
+        self._header = np.memmap(filename, dtype=WATERFALL_HEADER_DTYPE, mode='r', offset=0, shape=(1,))
+        header = self._header[0]
+        if header['magic'] != WATERFALL_MAGIC:
+            raise ValueError(f'{filename} is not a waterfall file')
+
+        self.num_rows = int(header['num_rows'])
+        self.num_bins = int(header['num_bins'])
+        self.fft_size = int(header['fft_size'])
+        self.sample_rate = int(header['sample_rate'])
+        self.bin_width = float(header['bin_width'])
+        self.frequencies = np.memmap(filename, dtype='<f8', mode='r', offset=int(header['frequencies_offset']), shape=(self.num_bins,))
+        self.timestamps = np.memmap(filename, dtype='<u8', mode='r', offset=int(header['timestamps_offset']), shape=(self.num_rows,))
+        self.data = np.memmap(filename, dtype='<f4', mode='r', offset=int(header['data_offset']), shape=(self.num_rows, self.num_bins))
+
+    @property
+    def rows_written(self) -> int:
+        return int(self._header[0]['rows_written'])
+
+    @property
+    def write_row(self) -> int:
+        return int(self._header[0]['write_row'])
+
+    def latest(self, num_rows: int) -> tuple[np.ndarray[Any, Any], np.ndarray[Any, Any]]:
+        '''
+        Returns copies of the timestamps and rows of up to `num_rows` most recent complete sweeps, oldest first.
+        '''
+        header = self._header[0]
+        write_row = int(header['write_row'])
+        available = min(int(header['rows_written']), self.num_rows, num_rows)
+        rows = (write_row - available + np.arange(available)) % self.num_rows
+        return self.timestamps[rows], self.data[rows]
+
+
+RAW_FORMATS = {'SC16_Q11': np.int16, 'SC8_Q7': np.int8}
+
+
+def raw_header_filename(filename: str) -> str:
+    return f'{filename}.json'
+
+
+def write_raw_header(filename: str, data_format: str, sample_rate: int, frequency: int, start_timestamp: float, num_samples: int | None = None, **extra: Any) -> None:
+    '''
+    Writes the sidecar header of a raw recording next to it (<filename>.json).
+    Samples are interleaved little-endian I/Q of `data_format` (SC16_Q11 as int16, SC8_Q7 as int8).
+    '''
+    if data_format not in RAW_FORMATS:
+        raise ValueError(f'data_format should be one of {", ".join(RAW_FORMATS)}')
+
+    header = {
+        'format': data_format,
+        'sample_rate': int(sample_rate),
+        'frequency': int(frequency),
+        'start_timestamp': start_timestamp,
+        'start_time': datetime.fromtimestamp(start_timestamp, timezone.utc).isoformat(),
+        'num_samples': num_samples,
+        **extra,
+    }
+    with open(raw_header_filename(filename), 'w', encoding='utf-8') as file:
+        json.dump(header, file, indent=2)
+
+
+def read_raw_header(filename: str) -> dict[str, Any] | None:
+    '''Returns the sidecar header of a raw recording or None if there is none'''
+    try:
+        with open(raw_header_filename(filename), encoding='utf-8') as file:
+            return json.load(file)  # type: ignore
+    except FileNotFoundError:
+        return None
+
+
+class RawFileWriter:
+    '''
+    Writes a raw sample stream to a file in large blocks from a dedicated thread.
+    Two aligned blocks are used in turn: the caller receives straight into one (reserve() then commit()) while the other is written out.
+    With `direct` the file is opened with O_DIRECT where the OS and file system support it, so recordings bypass the page cache.
+    '''
+    def __init__(self, target: str | Any, block_size: int = 4 * 1024 * 1024, direct: bool = False, alignment: int = 4096) -> None:
+        self._alignment = alignment
+        self._block_size = max(alignment, -(-block_size // alignment) * alignment)
+        self._free: Queue[np.ndarray[Any, Any]] = Queue()
+        self._full: Queue[tuple[np.ndarray[Any, Any], int] | None] = Queue()
+        for _ in range(2):
+            self._free.put(self._aligned_block())
+
+        self._block: np.ndarray[Any, Any] | None = None
+        self._fill = 0
+        self._bytes_written = 0
+        self._error: OSError | None = None
+        self._direct = False
+
+        if isinstance(target, str):
+            flags = os.O_WRONLY | os.O_CREAT | os.O_TRUNC | getattr(os, 'O_BINARY', 0)
+            self._fd = -1
+            if direct and hasattr(os, 'O_DIRECT'):
+                try:
+                    self._fd = os.open(target, flags | os.O_DIRECT, 0o644)
+                    self._direct = True
+                except OSError:
+                    pass
+            if self._fd < 0:
+                self._fd = os.open(target, flags, 0o644)
+            self._owns_fd = True
+        else:
+            target.flush()
+            self._fd = target.fileno()
+            self._owns_fd = False
+
+        self._thread = Thread(target=self._write_blocks, daemon=True)
+        self._thread.start()
+
+    @property
+    def block_size(self) -> int:
+        return self._block_size
+
+    @property
+    def direct(self) -> bool:
+        return self._direct
+
+    @property
+    def bytes_written(self) -> int:
+        return self._bytes_written
+
+    def reserve(self, nbytes: int) -> np.ndarray[Any, Any]:
+        '''Returns a uint8 view of `nbytes` in the current block, waiting for a free block if both are being written'''
+        if nbytes > self._block_size:
+            raise ValueError(f'nbytes should be at most {self._block_size}')
+
+        if self._block is not None and self._fill + nbytes > self._block_size:
+            self._submit()
+
+        if self._block is None:
+            self._block = self._free.get()
+            self._fill = 0
+            if self._error is not None:
+                raise self._error
+
+        return self._block[self._fill:self._fill + nbytes]
+
+    def commit(self, nbytes: int) -> None:
+        '''Marks `nbytes` of the last reserved view as filled'''
+        self._fill += nbytes
+        if self._fill >= self._block_size:
+            self._submit()
+
+    def close(self) -> None:
+        if self._block is not None:
+            if self._fill:
+                self._submit()
+            else:
+                self._free.put(self._block)
+                self._block = None
+
+        self._full.put(None)
+        self._thread.join()
+        if self._owns_fd:
+            os.close(self._fd)
+
+        if self._error is not None:
+            raise self._error
+
+    def _aligned_block(self) -> np.ndarray[Any, Any]:
+        raw = np.empty(self._block_size + self._alignment, dtype=np.uint8)
+        offset = -raw.ctypes.data % self._alignment
+        return raw[offset:offset + self._block_size]
+
+    def _submit(self) -> None:
+        self._full.put((self._block, self._fill))  # type: ignore
+        self._block = None
+        self._fill = 0
+
+    def _write_blocks(self) -> None:
+        while True:
+            item = self._full.get()
+            if item is None:
+                break
+
+            block, size = item
+            if self._error is None:
+                try:
+                    self._write(block, size)
+                except OSError as ex:
+                    self._error = ex
+            self._free.put(block)
+
+    def _write(self, block: np.ndarray[Any, Any], size: int) -> None:
+        if self._direct and size % self._alignment:
+            # O_DIRECT only takes whole aligned blocks, the unaligned tail goes through the page cache
+            import fcntl
+            fcntl.fcntl(self._fd, fcntl.F_SETFL, fcntl.fcntl(self._fd, fcntl.F_GETFL) & ~os.O_DIRECT)
+            self._direct = False
+
+        view = memoryview(block)[:size]
+        while len(view):
+            view = view[os.write(self._fd, view):]
+        self._bytes_written += size
+
+
+COMPRESSED_MAGIC = b'PBRFIQC1'
+COMPRESSED_VERSION = 1
+COMPRESSED_HEADER_DTYPE = np.dtype([
+    ('magic', 'S8'),
+    ('version', '<u4'),
+    ('format', '<u4'),
+    ('codec', '<u4'),
+    ('bits', '<u4'),
+    ('block_samples', '<u4'),
+    ('reserved', '<u4'),
+    ('sample_rate', '<u8'),
+    ('frequency', '<u8'),
+    ('start_timestamp', '<f8'),
+    ('index_offset', '<u8'),
+])
+COMPRESSED_BLOCK_DTYPE = np.dtype([
+    ('payload_bytes', '<u4'),
+    ('num_samples', '<u4'),
+    ('first_sample', '<u8'),
+])
+COMPRESSED_INDEX_DTYPE = np.dtype([
+    ('first_sample', '<u8'),
+    ('offset', '<u8'),
+])
+
+
+def is_compressed_file(filename: str) -> bool:
+    try:
+        with open(filename, 'rb') as file:
+            return file.read(len(COMPRESSED_MAGIC)) == COMPRESSED_MAGIC
+    except OSError:
+        return False
+
+
+class CompressedFileWriter:
+    '''
+    Writes a compressed raw recording made of independent blocks, see pybladerf_iq_compress for the codecs.
+    The file starts with COMPRESSED_HEADER_DTYPE, every block is a COMPRESSED_BLOCK_DTYPE header followed by its payload,
+    and close() appends an index of (first_sample, offset) per block. Recordings that were not closed are indexed by scanning the blocks.
+    The writer takes the same reserve()/commit() calls as RawFileWriter, blocks are compressed on `num_workers` threads and written in order.
+    '''
+    def __init__(self, target: str | Any, data_format: str, sample_rate: int, frequency: int, codec: int = 0, bits: int = 8,
+                 block_samples: int = 65536, num_workers: int | None = None) -> None:
+        from concurrent.futures import ThreadPoolExecutor
+
+        if data_format not in RAW_FORMATS:
+            raise ValueError(f'data_format should be one of {", ".join(RAW_FORMATS)}')
+        if codec == 0 and not 2 <= bits <= 16:
+            raise ValueError('bits should be between 2 and 16')
+
+        self._dtype = RAW_FORMATS[data_format]
+        self._sample_bytes = 2 * np.dtype(self._dtype).itemsize
+        self._codec = codec
+        self._bits = bits
+        self._block_size = block_samples * self._sample_bytes
+        self._header = np.zeros(1, dtype=COMPRESSED_HEADER_DTYPE)
+        header = self._header[0]
+        header['magic'] = COMPRESSED_MAGIC
+        header['version'] = COMPRESSED_VERSION
+        header['format'] = list(RAW_FORMATS).index(data_format)
+        header['codec'] = codec
+        header['bits'] = bits
+        header['block_samples'] = block_samples
+        header['sample_rate'] = sample_rate
+        header['frequency'] = frequency
+
+        num_workers = num_workers or min(4, os.cpu_count() or 1)
+        self._executor = ThreadPoolExecutor(max_workers=num_workers)
+        self._free: Queue[np.ndarray[Any, Any]] = Queue()
+        self._full: Queue[Any] = Queue()
+        for _ in range(num_workers + 2):
+            self._free.put(np.empty(self._block_size, dtype=np.uint8))
+
+        self._block: np.ndarray[Any, Any] | None = None
+        self._fill = 0
+        self._num_samples = 0
+        self._bytes_written = 0
+        self._index: list[tuple[int, int]] = []
+        self._header_written = False
+        self._error: Exception | None = None
+
+        if isinstance(target, str):
+            self._fd = os.open(target, os.O_WRONLY | os.O_CREAT | os.O_TRUNC | getattr(os, 'O_BINARY', 0), 0o644)
+            self._owns_fd = True
+        else:
+            target.flush()
+            self._fd = target.fileno()
+            self._owns_fd = False
+
+        self._thread = Thread(target=self._write_blocks, daemon=True)
+        self._thread.start()
+
+    @property
+    def block_size(self) -> int:
+        return self._block_size
+
+    @property
+    def direct(self) -> bool:
+        return False
+
+    @property
+    def num_samples(self) -> int:
+        return self._num_samples
+
+    @property
+    def bytes_written(self) -> int:
+        '''Compressed bytes written so far'''
+        return self._bytes_written
+
+    @property
+    def start_timestamp(self) -> float:
+        return float(self._header[0]['start_timestamp'])
+
+    @start_timestamp.setter
+    def start_timestamp(self, value: float) -> None:
+        '''The start time is stored in the header, which is written together with the first block'''
+        self._header[0]['start_timestamp'] = value
+
+    def reserve(self, nbytes: int) -> np.ndarray[Any, Any]:
+        '''Returns a uint8 view of `nbytes` in the current block, waiting for a free block while all of them are being compressed'''
+        if nbytes > self._block_size:
+            raise ValueError(f'nbytes should be at most {self._block_size}')
+
+        if self._block is not None and self._fill + nbytes > self._block_size:
+            self._submit()
+
+        if self._block is None:
+            self._block = self._free.get()
+            self._fill = 0
+            if self._error is not None:
+                raise self._error
+
+        return self._block[self._fill:self._fill + nbytes]
+
+    def commit(self, nbytes: int) -> None:
+        '''Marks `nbytes` of the last reserved view as filled'''
+        self._fill += nbytes
+        if self._fill >= self._block_size:
+            self._submit()
+
+    def close(self) -> None:
+        if self._block is not None:
+            if self._fill:
+                self._submit()
+            else:
+                self._free.put(self._block)
+                self._block = None
+
+        self._full.put(None)
+        self._thread.join()
+        self._executor.shutdown()
+
+        try:
+            if self._error is None:
+                self._write_header()
+                self._write_index()
+        finally:
+            if self._owns_fd:
+                os.close(self._fd)
+
+        if self._error is not None:
+            raise self._error
+
+    def _submit(self) -> None:
+        num_samples = self._fill // self._sample_bytes
+        header = np.zeros(1, dtype=COMPRESSED_BLOCK_DTYPE)
+        header['num_samples'] = num_samples
+        header['first_sample'] = self._num_samples
+        self._num_samples += num_samples
+
+        self._full.put((header, self._executor.submit(self._encode, self._block, num_samples)))
+        self._block = None
+        self._fill = 0
+
+    def _encode(self, block: np.ndarray[Any, Any], num_samples: int) -> np.ndarray[Any, Any]:
+        try:
+            return pybladerf.pybladerf_iq_compress(block[:num_samples * self._sample_bytes].view(self._dtype), self._codec, self._bits)
+        finally:
+            self._free.put(block)
+
+    def _write_blocks(self) -> None:
+        while True:
+            item = self._full.get()
+            if item is None:
+                break
+
+            header, future = item
+            try:
+                payload = future.result()
+                if self._error is None:
+                    self._write_header()
+                    header['payload_bytes'] = payload.size
+                    self._index.append((int(header['first_sample'][0]), self._bytes_written))
+                    self._write(header.tobytes())
+                    self._write(payload)
+            except Exception as ex:
+                self._error = ex
+
+    def _write_header(self) -> None:
+        if not self._header_written:
+            self._header_written = True
+            self._write(self._header.tobytes())
+
+    def _write_index(self) -> None:
+        try:
+            os.lseek(self._fd, 0, os.SEEK_CUR)
+        except OSError:
+            # pipes get no index, readers scan the blocks instead
+            return
+
+        index = np.array(self._index, dtype=COMPRESSED_INDEX_DTYPE)
+        self._header[0]['index_offset'] = self._bytes_written
+        self._write(index.tobytes())
+        os.lseek(self._fd, 0, os.SEEK_SET)
+        os.write(self._fd, self._header.tobytes())
+
+    def _write(self, data: Any) -> None:
+        view = memoryview(data).cast('B')
+        self._bytes_written += len(view)
+        while len(view):
+            view = view[os.write(self._fd, view):]
+
+
+class CompressedFileReader:
+    '''
+    Reads a CompressedFileWriter recording. Blocks are decoded independently, so random access costs at most one block
+    and read_samples() decodes the blocks it spans on `num_workers` threads.
+    read(), seek() and tell() work on the decoded raw byte stream, which lets pybladerf_transfer replay the recording.
+    '''
+    def __init__(self, filename: str, num_workers: int | None = None) -> None:
+        from concurrent.futures import ThreadPoolExecutor
+
+        self._file = open(filename, 'rb')
+        self._map = mmap.mmap(self._file.fileno(), 0, access=mmap.ACCESS_READ)
+        self._data = np.frombuffer(self._map, dtype=np.uint8)
+        header = np.frombuffer(self._map, dtype=COMPRESSED_HEADER_DTYPE, count=1)[0]
+        if header['magic'] != COMPRESSED_MAGIC:
+            raise ValueError(f'{filename} is not a compressed recording')
+        if header['version'] != COMPRESSED_VERSION:
+            raise ValueError(f'{filename} has unsupported version {header["version"]}')
+
+        self.data_format = list(RAW_FORMATS)[int(header['format'])]
+        self.codec = int(header['codec'])
+        self.bits = int(header['bits'])
+        self.block_samples = int(header['block_samples'])
+        self.sample_rate = int(header['sample_rate'])
+        self.frequency = int(header['frequency'])
+        self.start_timestamp = float(header['start_timestamp'])
+        self._dtype = RAW_FORMATS[self.data_format]
+        self._sample_bytes = 2 * np.dtype(self._dtype).itemsize
+
+        index_offset = int(header['index_offset'])
+        if index_offset:
+            index = np.frombuffer(self._map, dtype=COMPRESSED_INDEX_DTYPE, offset=index_offset, count=(len(self._map) - index_offset) // COMPRESSED_INDEX_DTYPE.itemsize)
+            self._first_samples = index['first_sample'].astype(np.int64)
+            self._offsets = index['offset'].astype(np.int64)
+        else:
+            self._scan_blocks()
+
+        if len(self._offsets):
+            last = self._block_header(len(self._offsets) - 1)
+            self.num_samples = int(last['first_sample']) + int(last['num_samples'])
+        else:
+            self.num_samples = 0
+
+        self._num_workers = num_workers or min(4, os.cpu_count() or 1)
+        self._executor = ThreadPoolExecutor(max_workers=self._num_workers)
+        self._position = 0
+        self._cached: tuple[int, np.ndarray[Any, Any]] | None = None
+        self._prefetch: dict[int, Any] = {}
+
+    def __enter__(self) -> 'CompressedFileReader':
+        return self
+
+    def __exit__(self, *args: Any) -> None:
+        self.close()
+
+    @property
+    def num_blocks(self) -> int:
+        return len(self._offsets)
+
+    def close(self) -> None:
+        self._executor.shutdown(cancel_futures=True)
+        self._prefetch.clear()
+        self._cached = None
+        del self._data
+        self._map.close()
+        self._file.close()
+
+    def read_block(self, block: int) -> np.ndarray[Any, Any]:
+        '''Returns the interleaved I/Q values of one block in the recording's format'''
+        header = self._block_header(block)
+        offset = int(self._offsets[block]) + COMPRESSED_BLOCK_DTYPE.itemsize
+        payload = self._data[offset:offset + int(header['payload_bytes'])]
+        values = pybladerf.pybladerf_iq_decompress(payload, int(header['num_samples']) * 2, self.codec, self.bits)
+        return values if self._dtype is np.int16 else values.astype(self._dtype)
+
+    def block_at(self, sample: int) -> int:
+        '''Returns the block holding `sample`'''
+        if not 0 <= sample < self.num_samples:
+            raise IndexError('sample out of range')
+        return int(np.searchsorted(self._first_samples, sample, side='right')) - 1
+
+    def sample_at(self, timestamp: float) -> int:
+        '''Returns the index of the sample received at `timestamp` (seconds since the epoch)'''
+        return min(max(int(round((timestamp - self.start_timestamp) * self.sample_rate)), 0), self.num_samples)
+
+    def read_samples(self, start: int, count: int) -> np.ndarray[Any, Any]:
+        '''Returns up to `count` samples from `start` as interleaved I/Q values'''
+        count = max(min(count, self.num_samples - start), 0)
+        if count == 0:
+            return np.empty(0, dtype=self._dtype)
+
+        first = self.block_at(start)
+        last = self.block_at(start + count - 1)
+        blocks = list(self._executor.map(self.read_block, range(first, last + 1)))
+        values = blocks[0] if len(blocks) == 1 else np.concatenate(blocks)
+        offset = (start - int(self._first_samples[first])) * 2
+        return values[offset:offset + count * 2]
+
+    def read_time(self, timestamp: float, duration: float) -> np.ndarray[Any, Any]:
+        '''Returns the samples of `duration` seconds starting at `timestamp`'''
+        return self.read_samples(self.sample_at(timestamp), int(round(duration * self.sample_rate)))
+
+    def read(self, nbytes: int = -1) -> bytes:
+        '''Reads the decoded stream like a raw recording, the next blocks are decoded ahead on the worker threads'''
+        total = self.num_samples * self._sample_bytes
+        if nbytes < 0:
+            nbytes = total - self._position
+        nbytes = max(min(nbytes, total - self._position), 0)
+
+        chunks = []
+        while nbytes > 0:
+            sample = self._position // self._sample_bytes
+            block = self.block_at(sample)
+            values = self._decoded_block(block)
+            offset = self._position - int(self._first_samples[block]) * self._sample_bytes
+            chunk = values.view(np.uint8)[offset:offset + nbytes]
+            chunks.append(chunk.tobytes())
+            self._position += len(chunk)
+            nbytes -= len(chunk)
+
+        return b''.join(chunks)
+
+    def seek(self, offset: int, whence: int = os.SEEK_SET) -> int:
+        if whence == os.SEEK_CUR:
+            offset += self._position
+        elif whence == os.SEEK_END:
+            offset += self.num_samples * self._sample_bytes
+        self._position = max(offset, 0)
+        return self._position
+
+    def tell(self) -> int:
+        return self._position
+
+    def _decoded_block(self, block: int) -> np.ndarray[Any, Any]:
+        if self._cached is not None and self._cached[0] == block:
+            return self._cached[1]
+
+        future = self._prefetch.pop(block, None)
+        values = future.result() if future is not None else self.read_block(block)
+        self._cached = (block, values)
+
+        for stale in [b for b in self._prefetch if b <= block]:
+            del self._prefetch[stale]
+        for ahead in range(block + 1, min(block + 1 + self._num_workers, self.num_blocks)):
+            if ahead not in self._prefetch:
+                self._prefetch[ahead] = self._executor.submit(self.read_block, ahead)
+
+        return values
+
+    def _block_header(self, block: int) -> Any:
+        return np.frombuffer(self._map, dtype=COMPRESSED_BLOCK_DTYPE, offset=int(self._offsets[block]), count=1)[0]
+
+    def _scan_blocks(self) -> None:
+        first_samples = []
+        offsets = []
+        offset = COMPRESSED_HEADER_DTYPE.itemsize
+        while offset + COMPRESSED_BLOCK_DTYPE.itemsize <= len(self._map):
+            header = np.frombuffer(self._map, dtype=COMPRESSED_BLOCK_DTYPE, offset=offset, count=1)[0]
+            end = offset + COMPRESSED_BLOCK_DTYPE.itemsize + int(header['payload_bytes'])
+            if end > len(self._map) or header['num_samples'] == 0:
+                # the recording was cut off inside this block
+                break
+            first_samples.append(int(header['first_sample']))
+            offsets.append(offset)
+            offset = end
+
+        self._first_samples = np.array(first_samples, dtype=np.int64)
+        self._offsets = np.array(offsets, dtype=np.int64)
+
+
+QUICK_TUNE_FIELDS = ('freqsel', 'vcocap', 'nint', 'nfrac', 'flags', 'xb_gpio', 'nios_profile', 'rffe_profile', 'port', 'spdt')
+QUICK_TUNE_CACHE_VERSION = 1
+QUICK_TUNE_PROFILES = 256  # NIOS profile slots libbladeRF hands out per direction and open
+
+
+def expand_frequency_plan(frequencies: list[int], sample_rate: int, min_frequency: int, max_frequency: int, interleaved: bool = False) -> tuple[list[int], list[int], list[tuple[int, int]]]:
+    '''
+    Expand [start, stop, ...] ranges in MHz into hop frequencies in Hz, every range is rounded up to whole sample_rate steps.
+    With `interleaved` each step is covered by two hops, a quarter of the sample rate apart.
+    Returns the hop frequencies, the range index of every hop and the rounded ranges in Hz.
+    '''
+    hop_frequencies = []
+    hop_ranges = []
+    ranges = []
+
+    for i in range(len(frequencies) // 2):
+        start = int(frequencies[2 * i] * 1e6)
+        stop = int(frequencies[2 * i + 1] * 1e6)
+
+        if start >= stop:
+            raise RuntimeError('max frequency must be greater than min frequency.')
+
+        step_count = 1 + (stop - start - 1) // sample_rate
+        stop = int(start + step_count * sample_rate)
+
+        if start < min_frequency:
+            raise RuntimeError(f'min frequency must must be greater than {int(min_frequency / 1e6)} MHz.')
+        if stop > max_frequency:
+            raise RuntimeError(f'max frequency may not be higher {int(max_frequency / 1e6)} MHz.')
+
+        frequency = start
+        if interleaved:
+            for j in range(step_count * 2):
+                hop_frequencies.append(frequency)
+                frequency += int(sample_rate / 4) if j % 2 == 0 else int(3 * sample_rate / 4)
+        else:
+            for j in range(step_count):
+                hop_frequencies.append(frequency)
+                frequency += sample_rate
+
+        hop_ranges.extend([i] * (len(hop_frequencies) - len(hop_ranges)))
+        ranges.append((start, stop))
+
+    return hop_frequencies, hop_ranges, ranges
+
+
+def quick_tune_cache_filename() -> str | None:
+    '''Returns the quick tune cache file (pybladerf_quick_tune_cache), None when it is set empty to disable the cache'''
+    default = os.path.join(os.environ.get('XDG_CACHE_HOME', os.path.join(os.path.expanduser('~'), '.cache')), 'python_bladerf', 'quick_tune.json')
+    return os.environ.get('pybladerf_quick_tune_cache', default) or None
+
+
+def _read_quick_tune_cache(filename: str) -> dict[str, Any]:
+    try:
+        with open(filename, encoding='utf-8') as file:
+            cache = json.load(file)
+        if cache.get('version') == QUICK_TUNE_CACHE_VERSION:
+            return cache  # type: ignore
+    except (OSError, ValueError, AttributeError):
+        pass
+    return {'version': QUICK_TUNE_CACHE_VERSION, 'devices': {}}
+
+
+def _write_quick_tune_cache(filename: str, cache: dict[str, Any]) -> None:
+    os.makedirs(os.path.dirname(os.path.abspath(filename)), exist_ok=True)
+    temporary = f'{filename}.{os.getpid()}.tmp'
+    with open(temporary, 'w', encoding='utf-8') as file:
+        json.dump(cache, file)
+    os.replace(temporary, filename)
+
+
+def _rfic_temperature(device: Any) -> float | None:
+    try:
+        return float(device.pybladerf_get_rfic_temperature())
+    except Exception:
+        # bladeRF 1 has no RFIC temperature sensor
+        return None
+
+
+def load_quick_tunes(device: Any, channel: int, frequencies: list[int], offset: int, sample_rate: int, print_to_console: bool = False) -> list[tuple[int, Any]]:
+    '''
+    Returns (frequency, pybladerf_quick_tune) for every hop of a sweep or scan plan, tuned to frequency + offset.
+    Hops on the same LO frequency share one profile, so only distinct LO frequencies count against QUICK_TUNE_PROFILES.
+    Plans with more than QUICK_TUNE_PROFILES distinct LO frequencies raise RuntimeError, the NIOS slots can not be paged.
+    Profiles are kept in an on-disk cache per device serial and direction, together with the channel, sample rate, FPGA, firmware
+    and library versions, tuning mode and RFIC temperature they were made with. A cache entry is used only if all of those still match
+    (the temperature within pybladerf_quick_tune_cache_max_temperature_delta degrees) and it holds every hop of the plan.
+    On bladeRF 2 the profiles point into NIOS memory, which the FPGA loses on reload, so a few cached profiles are recalled and
+    the LO frequency is read back before the entry is trusted. Otherwise all hops are tuned in one pass and the entry is replaced.
+    '''
+    tuned = list(dict.fromkeys(frequency + offset for frequency in frequencies))
+    if len(tuned) > QUICK_TUNE_PROFILES:
+        raise RuntimeError(f'Reached maximum number of quick tune profiles ({len(tuned)} LO frequencies, {QUICK_TUNE_PROFILES} supported, hops on the same LO share a profile). Please reduce the frequency range or increase the sample rate.')
+
+    filename = quick_tune_cache_filename()
+    if filename is None:
+        return _plan_quick_tunes(frequencies, offset, tuned, _fill_quick_tunes(device, channel, tuned)[0])
+
+    max_temperature_delta = float(os.environ.get('pybladerf_quick_tune_cache_max_temperature_delta', 10.0))
+    temperature = _rfic_temperature(device)
+    key = _quick_tune_cache_key(device, channel)
+    settings = _quick_tune_settings(device, channel, sample_rate)
+
+    cache = _read_quick_tune_cache(filename)
+    entry = cache['devices'].get(key)
+    reason = 'cold'
+    if entry is not None:
+        if entry.get('settings') != settings:
+            reason = 'settings changed'
+        elif temperature is not None and entry.get('temperature') is not None and abs(temperature - entry['temperature']) > max_temperature_delta:
+            reason = f'temperature changed by {temperature - entry["temperature"]:+.1f} C'
+        elif not all(str(frequency) in entry['profiles'] for frequency in tuned):
+            reason = 'new hops'
+        else:
+            quick_tunes = [pybladerf.pybladerf_quick_tune(*entry['profiles'][str(frequency)]['quick_tune']) for frequency in tuned]
+            if _verify_quick_tunes(device, channel, tuned, quick_tunes, entry):
+                if print_to_console:
+                    sys.stderr.write(f'Loaded {len(tuned)} quick tune profiles from {filename}\n')
+                return _plan_quick_tunes(frequencies, offset, tuned, quick_tunes)
+            reason = 'profiles are no longer loaded'
+
+    if print_to_console:
+        sys.stderr.write(f'Tuning {len(tuned)} quick tune profiles ({reason})\n')
+
+    quick_tunes, readbacks = _fill_quick_tunes(device, channel, tuned)
+
+    # the NIOS profile slots are reassigned on every fill, so an entry never mixes two fills
+    cache['devices'][key] = {
+        'settings': settings,
+        'temperature': temperature,
+        'created': time.time(),
+        'profiles': {
+            str(frequency): {'quick_tune': [getattr(quick_tune, field) for field in QUICK_TUNE_FIELDS], 'readback': readback}
+            for frequency, quick_tune, readback in zip(tuned, quick_tunes, readbacks)
+        },
+    }
+    try:
+        _write_quick_tune_cache(filename, cache)
+    except OSError as ex:
+        if print_to_console:
+            sys.stderr.write(f'Couldn\'t write the quick tune cache: {ex}\n')
+
+    return _plan_quick_tunes(frequencies, offset, tuned, quick_tunes)
+
+
+def _quick_tune_cache_key(device: Any, channel: int) -> str:
+    return f'{device.pybladerf_get_serial()}:{"TX" if channel & 1 else "RX"}'
+
+
+def _quick_tune_settings(device: Any, channel: int, sample_rate: int) -> dict[str, Any]:
+    return {
+        'channel': channel,
+        'sample_rate': sample_rate,
+        'board': device.pybladerf_get_board_name(),
+        'fpga_version': str(device.pybladerf_fpga_version()),
+        'fw_version': str(device.pybladerf_fw_version()),
+        'library_version': str(pybladerf.pybladerf_library_version()),
+        'tuning_mode': int(device.pybladerf_get_tuning_mode()),
+    }
+
+
+def _plan_quick_tunes(frequencies: list[int], offset: int, tuned: list[int], quick_tunes: list[Any]) -> list[tuple[int, Any]]:
+    profiles = dict(zip(tuned, quick_tunes))
+    return [(frequency, profiles[frequency + offset]) for frequency in frequencies]
+
+
+def _fill_quick_tunes(device: Any, channel: int, tuned: list[int]) -> tuple[list[Any], list[int]]:
+    quick_tunes = []
+    readbacks = []
+    for frequency in tuned:
+        device.pybladerf_set_frequency(channel, frequency)
+        readbacks.append(int(device.pybladerf_get_frequency(channel)))
+        quick_tunes.append(device.pybladerf_get_quick_tune(channel))
+    return quick_tunes, readbacks
+
+
+def _verify_quick_tunes(device: Any, channel: int, tuned: list[int], quick_tunes: list[Any], entry: dict[str, Any]) -> bool:
+    if entry['settings']['board'] != 'bladerf2':
+        # bladeRF 1 profiles hold the whole synthesizer state
+        return True
+
+    checks = sorted({0, len(tuned) // 2, len(tuned) - 1})
+    try:
+        for i in checks:
+            device.pybladerf_schedule_retune(channel, pybladerf.PYBLADERF_RETUNE_NOW, 0, quick_tunes[i])
+            time.sleep(0.001)
+            if abs(int(device.pybladerf_get_frequency(channel)) - entry['profiles'][str(tuned[i])]['readback']) > 1:
+                return False
+    except Exception:
+        return False
+    return True
+
+
+def _settle_time_key(num_channels: int) -> str:
+    # settle times measured on an RX_X2 stream are kept apart from single channel ones
+    return 'settle_us' if num_channels == 1 else f'settle_us_x{num_channels}'
+
+
+def load_settle_times(device: Any, channel: int, frequencies: list[int], offset: int, sample_rate: int, num_channels: int = 1) -> list[int] | None:
+    '''
+    Returns the calibrated settle time in samples for every hop from the quick tune cache entry made by load_quick_tunes,
+    or None if any hop has not been calibrated with the current profiles and `num_channels`.
+    '''
+    filename = quick_tune_cache_filename()
+    if filename is None:
+        return None
+
+    entry = _read_quick_tune_cache(filename)['devices'].get(_quick_tune_cache_key(device, channel))
+    if entry is None or entry.get('settings') != _quick_tune_settings(device, channel, sample_rate):
+        return None
+
+    settle_times = []
+    for frequency in frequencies:
+        settle_us = entry['profiles'].get(str(frequency + offset), {}).get(_settle_time_key(num_channels))
+        if settle_us is None:
+            return None
+        settle_times.append(int(settle_us * sample_rate // 1_000_000))
+    return settle_times
+
+
+def store_settle_times(device: Any, channel: int, frequencies: list[int], offset: int, sample_rate: int, settle_times: list[int], num_channels: int = 1) -> None:
+    '''Adds settle times (in samples) calibrated with `num_channels` to the profiles of the quick tune cache entry made by load_quick_tunes'''
+    filename = quick_tune_cache_filename()
+    if filename is None:
+        return
+
+    cache = _read_quick_tune_cache(filename)
+    entry = cache['devices'].get(_quick_tune_cache_key(device, channel))
+    if entry is None or entry.get('settings') != _quick_tune_settings(device, channel, sample_rate):
+        return
+
+    for frequency, settle_time in zip(frequencies, settle_times):
+        profile = entry['profiles'].get(str(frequency + offset))
+        if profile is not None:
+            profile[_settle_time_key(num_channels)] = settle_time * 1_000_000 // sample_rate
+    try:
+        _write_quick_tune_cache(filename, cache)
+    except OSError:
+        pass
+
+
+def settle_point(values: np.ndarray[Any, Any], block: int, max_await: int) -> int:
+    '''
+    Returns the number of samples after which a capture that starts at a retune no longer shows transients.
+    `values` are interleaved I/Q covering at least `max_await` samples followed by a settled tail. The block power and DC of the first
+    `max_await` samples are compared with the spread of the tail blocks, the settle point is the end of the last block outside it.
+    '''
+    num_blocks = len(values) // (2 * block)
+    await_blocks = min(-(-max_await // block), num_blocks - 2)
+    iq = values[:num_blocks * block * 2].reshape(num_blocks, block, 2).astype(np.float32)
+
+    power = 10 * np.log10((iq * iq).sum(axis=2).mean(axis=1) + 1e-12)
+    dc = iq.mean(axis=1)
+
+    tail_power = power[await_blocks:]
+    reference_power = np.median(tail_power)
+    power_tolerance = max(1.0, 4 * 1.4826 * float(np.median(np.abs(tail_power - reference_power))))
+
+    tail_dc = dc[await_blocks:]
+    reference_dc = np.median(tail_dc, axis=0)
+    dc_distance = np.hypot(*(dc - reference_dc).T)
+    dc_tolerance = max(4 * 1.4826 * float(np.median(dc_distance[await_blocks:])), 4 * float(np.sqrt(10 ** (reference_power / 10) / (2 * block))), 1.0)
+
+    unsettled = (np.abs(power - reference_power) > power_tolerance) | (dc_distance > dc_tolerance)
+    unsettled = np.flatnonzero(unsettled[:await_blocks])
+    return int(unsettled[-1] + 1) * block if len(unsettled) else 0
+
+
+def calibrate_settle_times(device: Any, channel: int, quick_tunes: list[tuple[int, Any]], sample_rate: int, max_await: int,
+                           oversample: bool, print_to_console: bool = False, num_channels: int = 1) -> list[int]:
+    '''
+    Measures the settle time in samples of every hop of `quick_tunes` (as returned by load_quick_tunes), at most `max_await`.
+    Each distinct profile is retuned to on its own and a window starting at the retune is captured and passed to settle_point,
+    `pybladerf_settle_calibration_passes` times. The longest result plus `pybladerf_settle_calibration_margin` ms is used.
+    The stream has to be configured with a *_META format and the module enabled, with `num_channels` 2 for RX_X2 (only the first channel is measured).
+    '''
+    time_1ms = sample_rate // 1000
+    passes = max(1, int(os.environ.get('pybladerf_settle_calibration_passes', 2)))
+    margin = int(time_1ms * float(os.environ.get('pybladerf_settle_calibration_margin', 0.1)))
+    block = max(16, time_1ms // 20)
+    window = -(-(max_await + max(max_await // 2, 8 * block)) // block) * block
+
+    buffer = np.empty(window * 2 * num_channels, dtype=np.int8 if oversample else np.int16)
+    meta = pybladerf.pybladerf_metadata()
+    profiles = list({id(quick_tune): quick_tune for _, quick_tune in quick_tunes}.values())
+    # calibration picks its own RFIC fast lock slots, on copies so the caller's profiles keep theirs
+    copies = [pybladerf.pybladerf_quick_tune(*[getattr(quick_tune, field) for field in QUICK_TUNE_FIELDS]) for quick_tune in profiles]
+    settle: dict[int, int] = {}
+
+    if print_to_console:
+        sys.stderr.write(f'Calibrating settle time of {len(profiles)} quick tune profiles\n')
+
+    for _ in range(passes):
+        for i, (quick_tune, copy) in enumerate(zip(profiles, copies)):
+            copy.rffe_profile = i % 8
+            lead = time_1ms * 5
+            while True:
+                timestamp = device.pybladerf_get_timestamp(pybladerf.pybladerf_direction.PYBLADERF_RX) + lead
+                device.pybladerf_schedule_retune(channel, timestamp, 0, copy)
+                meta.timestamp = timestamp
+                try:
+                    device.pybladerf_sync_rx(buffer, window * num_channels, meta, 0)
+                    break
+                except pybladerf.PYBLADERF_ERR_TIME_PAST:
+                    # the missed retune is still queued and would fire in the middle of the next window
+                    device.pybladerf_cancel_scheduled_retunes(channel)
+                    if lead > time_1ms * 100:
+                        raise
+                    lead *= 2
+
+            values = buffer if num_channels == 1 else buffer.reshape(window, num_channels, 2)[:, 0].reshape(-1)
+            settle[id(quick_tune)] = max(settle.get(id(quick_tune), 0), settle_point(values, block, max_await))
+
+    settle_times = [min(max_await, settle[id(quick_tune)] + margin) for _, quick_tune in quick_tunes]
+    if print_to_console:
+        sys.stderr.write(f'Settle time {min(settle_times) / time_1ms:.2f} - {max(settle_times) / time_1ms:.2f} ms (was {max_await / time_1ms:.2f} ms), '
+                         f'{(max_await * len(settle_times) - sum(settle_times)) / time_1ms:.1f} ms saved per sweep\n')
+    return settle_times
@@ -23,12 +23,194 @@
 # distutils: language = c++
 # cython: language_level = 3str
 # cython: freethreading_compatible = True
+from libc.stdint cimport int8_t, int16_t, int32_t, int64_t, uint8_t, uint16_t, uint32_t, uint64_t
+from cpython.ref cimport PyObject
+from libcpp.atomic cimport atomic, memory_order_relaxed, memory_order_acquire, memory_order_release
 from libcpp cimport bool as c_bool
 from . cimport cbladerf
+cimport cython
+
+cdef enum pybladerf_buffer_state:
+    PYBLADERF_BUFFER_FREE
+    PYBLADERF_BUFFER_IN_FLIGHT
+    PYBLADERF_BUFFER_LEASED
+
+cdef struct pybladerf_ring:
+    size_t *slots
+    size_t capacity
+    atomic[size_t] head
+    atomic[size_t] tail
+
+cdef enum:
+    PYBLADERF_RING_WAIT_US = 100_000
+
+cdef extern from 'pybladerf_simd.h' nogil:
+    enum:
+        PYBLADERF_IQ_HIST_BINS
+
+    ctypedef struct pybladerf_iq_stats_acc:
+        uint64_t samples
+        uint64_t power
+        uint64_t peak
+        uint64_t clipped
+        int64_t sum_i
+        int64_t sum_q
+        uint64_t histogram[PYBLADERF_IQ_HIST_BINS]
+
+    const char *pybladerf_simd_name()
+    void pybladerf_psd_prepare[T](const T *samples, const float *window, float *out, size_t n)
+    void pybladerf_psd_power(const float *spectrum, float *out, size_t n, float norm, int shift)
+    void pybladerf_psd_power_sum(const float *a, const float *b, float *out, size_t n, float norm, int shift)
+    void pybladerf_deinterleave_x2[T](const T *input, T *out0, T *out1, size_t n)
+    void pybladerf_iq_to_float[T](const T *input, float *out, size_t count, float scale)
+    void pybladerf_iq_from_float[T](const float *input, T *out, size_t count, float scale, float lo, float hi)
+    void pybladerf_iq_stats_clear(pybladerf_iq_stats_acc *acc)
+    void pybladerf_iq_stats_update[T](const T *samples, size_t n, int32_t clip_level, int hist_shift, pybladerf_iq_stats_acc *acc)
+
+cdef extern from 'pybladerf_codec.h' nogil:
+    size_t PYBLADERF_CODEC_ERROR
+    size_t pybladerf_codec_bound(size_t count, int codec, int bits)
+    size_t pybladerf_iq_encode(const int16_t *input, size_t count, int codec, int bits, uint8_t *out)
+    size_t pybladerf_iq_decode(const uint8_t *input, size_t size, size_t count, int codec, int bits, int16_t *out)
+
+cdef extern from *:
+    '''
+    #include <chrono>
+    #include <condition_variable>
+    #include <cstdint>
+    #include <mutex>
+    #include <thread>
+
+    static inline uint64_t pybladerf_monotonic_us(void) {
+        return (uint64_t) std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    static inline uint64_t pybladerf_wallclock_us(void) {
+        return (uint64_t) std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    static inline void pybladerf_sleep_us(unsigned int us) {
+        std::this_thread::sleep_for(std::chrono::microseconds(us));
+    }
+
+    // wakes a consumer waiting on a ring, the counter makes a notify between check and wait visible
+    struct pybladerf_signal {
+        std::mutex lock;
+        std::condition_variable cond;
+        uint64_t count = 0;
+    };
+
+    static inline pybladerf_signal *pybladerf_signal_new(void) {
+        return new pybladerf_signal();
+    }
+
+    static inline void pybladerf_signal_free(pybladerf_signal *signal) {
+        delete signal;
+    }
+
+    static inline uint64_t pybladerf_signal_count(pybladerf_signal *signal) {
+        std::lock_guard<std::mutex> guard(signal->lock);
+        return signal->count;
+    }
+
+    static inline void pybladerf_signal_notify(pybladerf_signal *signal) {
+        {
+            std::lock_guard<std::mutex> guard(signal->lock);
+            signal->count++;
+        }
+        signal->cond.notify_all();
+    }
+
+    static inline void pybladerf_signal_wait(pybladerf_signal *signal, uint64_t seen, uint64_t timeout_us) {
+        std::unique_lock<std::mutex> guard(signal->lock);
+        signal->cond.wait_for(guard, std::chrono::microseconds(timeout_us), [&] { return signal->count != seen; });
+    }
+
+    // statistics published once per buffer by a streaming thread and taken by a poller as one consistent snapshot
+    struct pybladerf_iq_stats_shared {
+        std::mutex lock;
+        pybladerf_iq_stats_acc acc;
+    };
+
+    static inline pybladerf_iq_stats_shared *pybladerf_iq_stats_new(void) {
+        pybladerf_iq_stats_shared *stats = new pybladerf_iq_stats_shared();
+        pybladerf_iq_stats_clear(&stats->acc);
+        return stats;
+    }
+
+    static inline void pybladerf_iq_stats_free(pybladerf_iq_stats_shared *stats) {
+        delete stats;
+    }
+
+    static inline void pybladerf_iq_stats_publish(pybladerf_iq_stats_shared *stats, const pybladerf_iq_stats_acc *acc) {
+        std::lock_guard<std::mutex> guard(stats->lock);
+        pybladerf_iq_stats_merge(&stats->acc, acc);
+    }
+
+    static inline void pybladerf_iq_stats_take(pybladerf_iq_stats_shared *stats, pybladerf_iq_stats_acc *out, int reset) {
+        std::lock_guard<std::mutex> guard(stats->lock);
+        *out = stats->acc;
+        if (reset)
+            pybladerf_iq_stats_clear(&stats->acc);
+    }
+    '''
+    ctypedef struct pybladerf_signal:
+        pass
+
+    ctypedef struct pybladerf_iq_stats_shared:
+        pass
+
+    uint64_t pybladerf_monotonic_us() nogil
+    uint64_t pybladerf_wallclock_us() nogil
+    void pybladerf_sleep_us(unsigned int us) nogil
+    pybladerf_signal *pybladerf_signal_new() nogil
+    void pybladerf_signal_free(pybladerf_signal *signal) nogil
+    uint64_t pybladerf_signal_count(pybladerf_signal *signal) nogil
+    void pybladerf_signal_notify(pybladerf_signal *signal) nogil
+    void pybladerf_signal_wait(pybladerf_signal *signal, uint64_t seen, uint64_t timeout_us) nogil
+    pybladerf_iq_stats_shared *pybladerf_iq_stats_new() nogil
+    void pybladerf_iq_stats_free(pybladerf_iq_stats_shared *stats) nogil
+    void pybladerf_iq_stats_publish(pybladerf_iq_stats_shared *stats, const pybladerf_iq_stats_acc *acc) nogil
+    void pybladerf_iq_stats_take(pybladerf_iq_stats_shared *stats, pybladerf_iq_stats_acc *out, int reset) nogil
+
+# single producer / single consumer ring of buffer indices, head and tail only grow
+cdef inline c_bool pybladerf_ring_push(pybladerf_ring *ring, size_t value) noexcept nogil:
+    cdef size_t tail = ring.tail.load(memory_order_relaxed)
+    if tail - ring.head.load(memory_order_acquire) == ring.capacity:
+        return False
+    ring.slots[tail % ring.capacity] = value
+    ring.tail.store(tail + 1, memory_order_release)
+    return True
+
+cdef inline c_bool pybladerf_ring_pop(pybladerf_ring *ring, size_t *value) noexcept nogil:
+    cdef size_t head = ring.head.load(memory_order_relaxed)
+    if ring.tail.load(memory_order_acquire) == head:
+        return False
+    value[0] = ring.slots[head % ring.capacity]
+    ring.head.store(head + 1, memory_order_release)
+    return True
+
+# pop for a ring that more than one consumer takes from, the producer side stays single
+cdef inline c_bool pybladerf_ring_pop_shared(pybladerf_ring *ring, size_t *value) noexcept nogil:
+    cdef size_t head = ring.head.load(memory_order_acquire)
+    while ring.tail.load(memory_order_acquire) != head:
+        value[0] = ring.slots[head % ring.capacity]
+        if ring.head.compare_exchange_weak(head, head + 1):
+            return True
+    return False
+
+cdef inline size_t pybladerf_ring_size(pybladerf_ring *ring) noexcept nogil:
+    return ring.tail.load(memory_order_acquire) - ring.head.load(memory_order_acquire)
 
 cdef struct pybladerf_async_data:
     void* pystream
 
+    # resolved once at init, the stream callbacks never look them up again
+    PyObject *device
+    PyObject *callback
+    PyObject *complete_callback
+    PyObject *valid_num_samples
+
     int bytes_per_sample
 
     int package_size
@@ -36,6 +218,78 @@ cdef struct pybladerf_async_data:
     int samples_per_package
 
     c_bool tx_complete
+    c_bool zero_copy
+
+    c_bool meta
+    c_bool has_timestamp
+    uint64_t next_timestamp
+    atomic[uint64_t] discontinuities
+    atomic[uint64_t] overruns
+
+    c_bool native
+    c_bool tx_stream
+    pybladerf_ring filled_ring
+    pybladerf_ring free_ring
+    pybladerf_signal *ring_signal
+    void *silence_buffer
+    atomic[c_bool] shutdown_requested
+    atomic[uint64_t] overflows
+    atomic[uint64_t] underflows
+
+# retunes in flight are capped by the 8 RFIC fast lock profiles
+cdef enum:
+    PYBLADERF_HOP_MAX_LOOKAHEAD = 8
+
+cdef struct pybladerf_hop_step:
+    uint64_t frequency
+    uint64_t schedule_time
+    uint32_t dwell
+    uint32_t position
+    uint16_t hop
+    c_bool recovering
+
+cdef struct pybladerf_hop_plan:
+    cbladerf.bladerf *device
+    int channel
+
+    # per hop: quick tune, reported frequency, settle time and dwell in samples
+    uint16_t num_hops
+    cbladerf.bladerf_quick_tune *quick_tunes
+    uint64_t *frequencies
+    uint64_t *settle_times
+    uint32_t *dwells
+
+    # revisit order, one cycle of it is one sweep
+    uint16_t *order
+    uint32_t order_len
+    uint32_t position
+
+    pybladerf_hop_step steps[PYBLADERF_HOP_MAX_LOOKAHEAD]
+    uint8_t read_ptr
+    uint8_t write_ptr
+    uint8_t in_flight
+    uint8_t lookahead
+    uint8_t min_lookahead
+    uint8_t rffe_profiles
+    uint8_t free_rffe_profile
+    uint8_t recovering
+
+    uint64_t schedule_timestamp
+    uint64_t start_lead
+    uint64_t recovery_lead
+    uint64_t min_recovery_lead
+    uint64_t stable_hops
+
+    atomic[uint64_t] cycles
+    atomic[uint64_t] time_past_resets
+    atomic[uint64_t] missed_steps
+    atomic[uint64_t] recovered_steps
+
+# shared by the sweep and scan capture loops, all of them return a negative libbladeRF error code on failure
+cdef int pybladerf_hop_start(pybladerf_hop_plan *plan) noexcept nogil
+cdef int pybladerf_hop_fill(pybladerf_hop_plan *plan) noexcept nogil
+cdef int pybladerf_hop_complete(pybladerf_hop_plan *plan) noexcept nogil
+cdef int pybladerf_hop_resync(pybladerf_hop_plan *plan) noexcept nogil
 
 # ---- STRUCT ---- #
 cdef class pybladerf_devinfo:
@@ -92,19 +346,62 @@ cdef class pybladerf_stream:
     cdef cbladerf.bladerf_stream *__bladerf_stream
     cdef int idx
 
-    cdef pybladerf_async_data get_async_data(self)
+    cdef uint8_t *buffer_states
+    cdef list buffer_views
+    cdef list meta_views
+    cdef size_t pending_submits
+    cdef cython.pymutex buffer_lock
+
+    cdef pybladerf_async_data *get_async_data(self)
 
     cdef void *get_next_buffer_ptr(self)
 
+    cdef int _init_buffer_views(self, object dtype, size_t num_transfers, c_bool writeable) except -1
+
+    cdef int lease_buffer(self, void *buffer)
+
+    cdef int set_buffer_state(self, void *buffer, uint8_t state)
+
+    cdef void *get_free_buffer_ptr(self)
+
+    cdef int _init_meta_views(self) except -1
+
+    cdef int _init_native_rings(self, size_t num_transfers) except -1
+
+    cdef int _deinit(self) except -1
+
     cdef cbladerf.bladerf_stream *get_ptr(self)
 
     cdef cbladerf.bladerf_stream **get_double_ptr(self)
 
+cdef class pybladerf_iq_stats:
+    cdef pybladerf_iq_stats_shared *__stats
+    cdef c_bool oversample
+    cdef int32_t clip_level
+    cdef int hist_shift
+
+    cdef void update_ptr(self, const void *samples, size_t num_samples) noexcept nogil
+
+cdef class pybladerf_hop_scheduler:
+    cdef pybladerf_hop_plan *__plan
+    cdef object device
+    cdef c_bool started
+
+    cdef pybladerf_hop_plan *get_ptr(self)
+
 # ---- WRAPPER ---- #
 cdef class PyBladerfDevice:
     cdef cbladerf.bladerf *__bladerf_device
     cdef public str serialno
 
+    cdef object rx_callback
+    cdef object tx_callback
+    cdef object tx_complete_callback
+    cdef c_bool tx_complete_enabled
+    cdef size_t sync_rx_itemsize
+    cdef int rx_streams
+    cdef int tx_streams
+
     cdef cbladerf.bladerf *get_ptr(self)
 
     cdef cbladerf.bladerf **get_double_ptr(self)
@@ -112,3 +409,5 @@ cdef class PyBladerfDevice:
     cdef cbladerf.bladerf_backendinfo pybladerf_get_backendinfo(self)
 
     cdef void _setup_device(self)
+
+    cdef void _bind_callbacks(self, pybladerf_async_data *async_data, c_bool tx)
@@ -790,6 +790,34 @@ class pybladerf_sweep_style(IntEnum):
     def __str__(self) -> str:
         ...
 
+class pybladerf_sweep_drop_policy(IntEnum):
+    '''
+    Sweep buffer pool policy enum
+
+    Used by `pybladerf_sweep`, decides what happens to a new hop when every buffer of the pool is waiting for processing.
+    '''
+    PYBLADERF_SWEEP_DROP_POLICY_BLOCK = 0
+    '''capture waits for a free buffer, no hop is lost but the retune schedule restarts.'''
+    PYBLADERF_SWEEP_DROP_POLICY_DROP_NEWEST = 1
+    '''the new hop is received to keep the schedule and discarded.'''
+    PYBLADERF_SWEEP_DROP_POLICY_DROP_OLDEST = 2
+    '''the oldest hop that is still waiting for processing is overwritten by the new one.'''
+
+class pybladerf_iq_codec(IntEnum):
+    '''
+    Compressed IQ block codec enum
+
+    Used by `pybladerf_iq_compress`, `pybladerf_iq_decompress` and the compressed recordings of `pybladerf_transfer`.
+    '''
+    PYBLADERF_IQ_CODEC_BFP = 0
+    '''block floating point: every 32 values share a 4-bit exponent and keep `bits`-bit mantissas (lossy).'''
+    PYBLADERF_IQ_CODEC_LOSSLESS = 1
+    '''I and Q deltas, Rice coded (lossless).'''
+
+    @override
+    def __str__(self) -> str:
+        ...
+
 # ---- STRUCT ---- #
 class pybladerf_devinfo:
     '''Information about a bladeRF attached to the system'''
@@ -1177,6 +1205,79 @@ class pybladerf_stream:
         '''Async stream error code'''
         ...
 
+    @property
+    def leased_buffers(self) -> int:
+        '''Number of zero-copy buffers currently held by the user'''
+        ...
+
+    def release_buffer(self, buffer: np.ndarray[Any, Any]) -> None:
+        '''
+        Return a buffer leased by a zero-copy rx callback back to the stream.
+
+        If the stream ran out of free buffers while this one was leased, the buffer is submitted to the device immediately.
+
+        ! NOTE !
+            The buffer must not be accessed after it has been released
+        '''
+        ...
+
+    @property
+    def overflows(self) -> int:
+        '''Number of received buffers dropped because read() did not keep up (native mode)'''
+        ...
+
+    @property
+    def underflows(self) -> int:
+        '''Number of zero buffers transmitted because write() did not keep up (native mode)'''
+        ...
+
+    @property
+    def buffered(self) -> int:
+        '''Number of filled buffers waiting in the native ring'''
+        ...
+
+    @property
+    def discontinuities(self) -> int:
+        '''Number of received meta packages whose timestamp did not follow the previous package'''
+        ...
+
+    @property
+    def overruns(self) -> int:
+        '''Number of received meta packages flagged with PYBLADERF_META_FLAG_RX_HW_UNDERFLOW'''
+        ...
+
+    def read(self, n_buffers: int, timeout_ms: int = 0) -> np.ndarray[Any, Any]:
+        '''
+        Read up to `n_buffers` received buffers from a native rx stream.
+
+        Blocks without holding the GIL until `n_buffers` buffers are available, the timeout expires or the stream shuts down. A `timeout_ms` of 0 waits indefinitely.
+
+        Returns interleaved IQ samples (int16 for SC16_Q11, int8 for SC8_Q7), the length is a multiple of samples_per_buffer * 2.
+        '''
+        ...
+
+    def read_meta(self, n_buffers: int, timeout_ms: int = 0) -> tuple[np.ndarray[Any, Any], np.ndarray[Any, Any], np.ndarray[Any, Any]]:
+        '''
+        Same as read() for native rx streams with a meta format.
+
+        Package headers are stripped and the payloads are returned as one contiguous array of interleaved IQ samples, together with per-package timestamps (numpy.uint64) and flags (numpy.uint32).
+        '''
+        ...
+
+    def write(self, samples: np.ndarray[Any, Any], timeout_ms: int = 0) -> int:
+        '''
+        Queue interleaved IQ samples for transmission on a native tx stream.
+
+        Samples are split into stream buffers, the last one is zero padded. Blocks without holding the GIL until every buffer is queued, the timeout expires or the stream shuts down. A `timeout_ms` of 0 waits indefinitely.
+
+        Returns the number of samples queued.
+        '''
+        ...
+
+    def request_shutdown(self) -> None:
+        '''Ask a native stream callback to shut the stream down on its next invocation.'''
+        ...
+
 # ---- WRAPPER ---- #
 class PyBladeRFDeviceList:
     '''Class implementing list of BladeRF devices.'''
@@ -1229,6 +1330,102 @@ class PyBladeRFDeviceList:
         '''List of product description string of found devices'''
         ...
 
+class pybladerf_iq_stats:
+    '''
+    Running signal statistics of SC16_Q11 (SC8_Q7 with oversample) sample buffers.
+
+    update() is one native pass per buffer without temporaries: power, peak magnitude, clipped samples (|I| or |Q| at 2047 / 127),
+    I and Q DC offset and, if enabled, a 64 bin histogram of max(|I|, |Q|). Buffers can be added from a streaming thread
+    while another thread polls snapshot().
+    '''
+
+    def __init__(self, oversample: bool = False, histogram: bool = False) -> None:
+        ...
+
+    def update(self, samples: np.ndarray[Any, Any], num_samples: int | None = None) -> None:
+        '''Add `num_samples` interleaved samples (the whole array by default) to the statistics'''
+        ...
+
+    def snapshot(self, reset: bool = True) -> dict[str, Any]:
+        '''
+        Consistent copy of the statistics since the previous reset:
+        samples, power_dbfs, peak_dbfs, clipped, clipped_ratio, dc_i and dc_q (fractions of full scale) and histogram (uint64 array or None).
+        '''
+        ...
+
+class pybladerf_hop_scheduler:
+    '''
+    Timed retune plan shared by pybladerf_sweep and pybladerf_scan, usable for custom capture loops.
+
+    Every hop has a quick tune profile, a settle time and a dwell (both in samples). One cycle visits every hop `weight` times,
+    the visits of a hop are spread evenly over the cycle. Retunes are scheduled `lookahead` hops ahead of the capture (at most 8,
+    one RFIC fast lock profile each). After TIME_PAST, resync() cancels them and resumes at the first missed hop, the lookahead
+    grows and shrinks back after a cycle without misses. Leads default to 150 ms (start) and 5 ms (recovery) of the current sample rate.
+
+    Capture loop::
+
+        scheduler.start()
+        while running:
+            frequency, timestamp, dwell, hop = scheduler.next()
+            try:
+                device.pybladerf_sync_rx(buffer, dwell, meta, 0)  # meta.timestamp = timestamp
+            except pybladerf.PYBLADERF_ERR_TIME_PAST:
+                scheduler.resync()
+                continue
+            if scheduler.complete():
+                ...  # cycle done
+    '''
+
+    def __init__(self, device: PyBladerfDevice, channel: int, hops: list[tuple[int, pybladerf_quick_tune]], dwell: int | list[int], settle: int | list[int],
+                 weights: list[int] | None = None, lookahead: int = 4, start_lead: int | None = None, recovery_lead: int | None = None) -> None:
+        '''`hops` are (frequency, quick_tune) pairs as returned by utils.load_quick_tunes, the frequency is only reported back'''
+        ...
+
+    def start(self) -> None:
+        '''Schedule the first retunes `start_lead` samples from now, at the beginning of the cycle'''
+        ...
+
+    def next(self) -> tuple[int, int, int, int]:
+        '''Keep the lookahead full and return (frequency, timestamp, dwell, hop index) of the hop to capture next, raises RuntimeError before start()'''
+        ...
+
+    def complete(self) -> bool:
+        '''Mark the hop returned by next() as captured, True if it ended a cycle. Raises RuntimeError when no hop is in flight'''
+        ...
+
+    def resync(self) -> None:
+        '''Recover from TIME_PAST on the hop returned by next()'''
+        ...
+
+    @property
+    def num_hops(self) -> int:
+        ...
+
+    @property
+    def order(self) -> list[int]:
+        '''Hop indices of one cycle'''
+        ...
+
+    @property
+    def lookahead(self) -> int:
+        ...
+
+    @property
+    def cycles(self) -> int:
+        ...
+
+    @property
+    def time_past_resets(self) -> int:
+        ...
+
+    @property
+    def missed_steps(self) -> int:
+        ...
+
+    @property
+    def recovered_steps(self) -> int:
+        ...
+
 class PyBladerfDevice:
     '''
     Class implementing interaction with the device.
@@ -1661,7 +1858,22 @@ class PyBladerfDevice:
         '''
         ...
 
-    def pybladerf_init_rx_stream(self, num_buffers: int, data_format: pybladerf_format, samples_per_buffer: int, num_transfers: int) -> pybladerf_stream:
+    def pybladerf_sync_rx_many(self, samples: np.ndarray[Any, Any], num_samples: int, timestamps: np.ndarray[Any, Any] | None = None, timeout_ms: int = 0) -> tuple[np.ndarray[Any, Any], np.ndarray[Any, Any], np.ndarray[Any, Any]]:
+        '''
+        Receive several bursts in one call without returning to Python between them.
+
+        `samples` is a preallocated writeable [n_bursts, num_samples * 2] array, every row receives one burst of `num_samples` samples. Its dtype must match the configured format, numpy.int16 for SC16_Q11_META and numpy.int8 for SC8_Q7_META. `timestamps` holds the scheduled timestamp of every burst, if omitted each burst is received with PYBLADERF_META_FLAG_RX_NOW.
+
+        Returns three arrays with one entry per burst: the libbladeRF return code (numpy.int32, 0 on success), the actual timestamp of the first sample (numpy.uint64) and the metadata status flags (numpy.uint32, see PYBLADERF_META_STATUS_OVERRUN).
+
+        A failed burst does not stop the remaining ones, check the return codes.
+
+        ! NOTE !
+            The device must be configured with pybladerf_sync_config() using a meta format
+        '''
+        ...
+
+    def pybladerf_init_rx_stream(self, num_buffers: int, data_format: pybladerf_format, samples_per_buffer: int, num_transfers: int, zero_copy: bool = False, native: bool = False) -> pybladerf_stream:
         '''
         Initialize a rx stream for use with asynchronous routines.
 
@@ -1684,10 +1896,16 @@ class PyBladerfDevice:
         To account for general system overhead, it is recommended to multiply the righthand side by 1.1 to 1.25.
 
         While increasing the number of buffers available provides additional elasticity, be aware that it also increases latency.
+
+        With `zero_copy` enabled the rx callback receives a read-only view of the stream buffer instead of a copy. The buffer stays leased to the user until pystream.release_buffer() is called, so it can be handed off to another thread without copying. When every buffer is leased or in flight the stream waits for the next release, keep `num_buffers` comfortably above `num_transfers` to avoid overruns.
+
+        With `native` enabled the rx callback never takes the GIL. Filled buffers are passed through a lock-free ring and collected with pystream.read(), buffers that arrive while the ring is full are dropped and counted in pystream.overflows. `num_transfers` must be less than `num_buffers`, otherwise no buffer is ever free to swap in and every buffer is dropped. No python rx callback is called in this mode.
+
+        Meta formats (PYBLADERF_FORMAT_SC16_Q11_META, PYBLADERF_FORMAT_SC8_Q7_META) are supported, `samples_per_buffer` must then hold a whole number of USB packages (512 samples at SuperSpeed, 256 at HighSpeed for SC16_Q11_META). Package headers are stripped natively and the rx callback receives the payload together with per-package timestamps and flags, see set_rx_callback(). These arrays are preallocated per stream buffer and refilled when that buffer comes round again, copy whatever has to outlive the callback. Use pystream.read_meta() in native mode. Zero-copy mode does not support meta formats.
         '''
         ...
 
-    def pybladerf_init_tx_stream(self, num_buffers: int, data_format: pybladerf_format, samples_per_buffer: int, num_transfers: int) -> pybladerf_stream:
+    def pybladerf_init_tx_stream(self, num_buffers: int, data_format: pybladerf_format, samples_per_buffer: int, num_transfers: int, zero_copy: bool = False, native: bool = False) -> pybladerf_stream:
         '''
         Initialize a tx stream for use with asynchronous routines.
 
@@ -1710,6 +1928,12 @@ class PyBladerfDevice:
         To account for general system overhead, it is recommended to multiply the righthand side by 1.1 to 1.25.
 
         While increasing the number of buffers available provides additional elasticity, be aware that it also increases latency.
+
+        With `zero_copy` enabled the tx callback receives a writable view of the next free stream buffer and fills it in place, no temporary array is allocated and nothing is copied. The view still holds the samples it transmitted last time, samples past `valid_num_samples` are zeroed before transmission. Once transmitted, the same view is passed to the tx complete callback and the buffer returns to the pool. Meta formats are not supported in this mode.
+
+        With `native` enabled the tx callback never takes the GIL. Buffers queued with pystream.write() are taken from a lock-free ring, when the ring is empty a zeroed buffer is transmitted instead and counted in pystream.underflows. One buffer is reserved for these zeros, so `num_buffers` must be at least 2 and greater than `num_transfers`. Queue some samples before starting the stream to avoid initial underflows.
+
+        Meta formats are supported in callback mode, the tx callback fills the payload and per-package timestamps and flags and the package headers are written natively, see set_tx_callback(). The arrays are preallocated per stream buffer, the payload still holds what was transmitted from that buffer last time while timestamps and flags are cleared. Native mode does not support meta formats.
         '''
         ...
 
@@ -1750,6 +1974,8 @@ class PyBladerfDevice:
         Stream is no longer being used (via pybladerf_submit_stream_buffer() or pybladerf_stream() calls.)
 
         Stream is deallocated and may no longer be used.
+
+        Raises RuntimeError while zero-copy buffers are still leased, release them with pystream.release_buffer() first.
         '''
         ...
 
@@ -1972,11 +2198,11 @@ class PyBladerfDevice:
         This callback will be called whenever an USB transfer to the device is completed, regardless if it was successful or not
 
         ! NOTE !
-            Only for async mode
+            Only for async mode. Must be called before pybladerf_init_tx_stream(), raises RuntimeError while a tx stream of this device is initialized
         '''
 
     # ---- python callbacks setters ---- #
-    def set_rx_callback(self, rx_callback_function: Callable[[Self, pybladerf_stream, np.ndarray[Any, Any], int], int]) -> None:
+    def set_rx_callback(self, rx_callback_function: Callable[[Self, pybladerf_stream, np.ndarray[Any, Any], int], int] | Callable[[Self, pybladerf_stream, np.ndarray[Any, Any], int, np.ndarray[Any, Any], np.ndarray[Any, Any]], int]) -> None:
         '''
         Accept a 4 args that contains the device, pystream, buffer and number of complex samples in the buffer data.
         device: PyBladerfDevice, pystream: pybladerf_stream, buffer: numpy.array(dtype=numpy.int8 | numpy.int16), num_samples: int
@@ -1984,10 +2210,15 @@ class PyBladerfDevice:
         Should copy/process the contents of the buffer's valid part.
 
         The callback should return 0 if it wants to be called again, and any other value otherwise.
+
+        For meta formats the callback accepts 2 more args, the timestamp and flags of every USB package in the buffer.
+        device: PyBladerfDevice, pystream: pybladerf_stream, buffer: numpy.array(dtype=numpy.int8 | numpy.int16), num_samples: int, timestamps: numpy.array(dtype=numpy.uint64), flags: numpy.array(dtype=numpy.uint32)
+
+        The callback is bound to a stream in pybladerf_init_rx_stream(), set it before initializing the stream. Raises RuntimeError while a rx stream of this device is initialized.
         '''
         ...
 
-    def set_tx_callback(self, tx_callback_function: Callable[[Self, pybladerf_stream, np.ndarray[Any, Any], int, int], int]) -> None:
+    def set_tx_callback(self, tx_callback_function: Callable[[Self, pybladerf_stream, np.ndarray[Any, Any], int, int], int] | Callable[[Self, pybladerf_stream, np.ndarray[Any, Any], int, int, np.ndarray[Any, Any], np.ndarray[Any, Any]], int]) -> None:
         '''
         Accept a 5 args that contains the device, pystream, buffer, the number of complex samples and the valid complex samples in the buffer data.
         device: PyBladerfDevice, pystream: pybladerf_stream, buffer: numpy.array(dtype=numpy.int8 | numpy.int16), num_samples: int, valid_num_samples: int
@@ -1996,6 +2227,11 @@ class PyBladerfDevice:
         You should change the value of the valid_num_samples variable to the number of modified samples in the buffer.
 
         return 1 if you will call pybladerf_submit_stream_buffer() or pybladerf_submit_stream_buffer_nb()
+
+        For meta formats the callback accepts 2 more args that should be filled with the timestamp and flags of every USB package in the buffer. Samples past valid_num_samples are transmitted as zeros.
+        device: PyBladerfDevice, pystream: pybladerf_stream, buffer: numpy.array(dtype=numpy.int8 | numpy.int16), num_samples: int, valid_num_samples: int, timestamps: numpy.array(dtype=numpy.uint64), flags: numpy.array(dtype=numpy.uint32)
+
+        The callback is bound to a stream in pybladerf_init_tx_stream(), set it before initializing the stream. Raises RuntimeError while a tx stream of this device is initialized.
         '''
         ...
 
@@ -2003,6 +2239,8 @@ class PyBladerfDevice:
         '''
         Accept a 4 args that contains the device, buffer and number of complex samples in the buffer data.
         device: PyBladerfDevice, pystream: pybladerf_stream, buffer: numpy.array(dtype=numpy.int8 | numpy.int16), num_samples: int
+
+        The callback is bound to a stream in pybladerf_init_tx_stream(), set it before initializing the stream. Raises RuntimeError while a tx stream of this device is initialized.
         '''
         ...
 
@@ -2063,3 +2301,45 @@ def pybladerf_library_version() -> pybladerf_version:
 def python_bladerf_library_version() -> pybladerf_version:
     '''Get python_bladerf version information '''
     ...
+
+def pybladerf_sc16_q11_to_complex64(samples: np.ndarray[Any, Any], out: np.ndarray[Any, Any] | None = None) -> np.ndarray[Any, Any]:
+    '''
+    Convert interleaved SC16_Q11 samples (int16 I, Q, I, Q, ...) to complex64 scaled to [-1.0, 1.0).
+
+    If `out` is given it must be a contiguous complex64 array of at least len(samples) // 2 values; the returned array is a view of it.
+    '''
+    ...
+
+def pybladerf_sc8_q7_to_complex64(samples: np.ndarray[Any, Any], out: np.ndarray[Any, Any] | None = None) -> np.ndarray[Any, Any]:
+    '''Same as pybladerf_sc16_q11_to_complex64 for SC8_Q7 (int8) samples'''
+    ...
+
+def pybladerf_complex64_to_sc16_q11(samples: np.ndarray[Any, Any], out: np.ndarray[Any, Any] | None = None) -> np.ndarray[Any, Any]:
+    '''
+    Convert complex64 samples to interleaved SC16_Q11. Values are rounded to nearest and saturated to [-2048, 2047].
+
+    If `out` is given it must be a contiguous int16 array of at least len(samples) * 2 values; the returned array is a view of it.
+    '''
+    ...
+
+def pybladerf_complex64_to_sc8_q7(samples: np.ndarray[Any, Any], out: np.ndarray[Any, Any] | None = None) -> np.ndarray[Any, Any]:
+    '''Same as pybladerf_complex64_to_sc16_q11 for SC8_Q7, saturated to [-128, 127]'''
+    ...
+
+def pybladerf_iq_compress(samples: np.ndarray[Any, Any], codec: pybladerf_iq_codec = pybladerf_iq_codec.PYBLADERF_IQ_CODEC_BFP, bits: int = 8) -> np.ndarray[Any, Any]:
+    '''
+    Compress interleaved SC16_Q11 values (SC8_Q7 values are widened) into one self-contained block and return its bytes as a uint8 array.
+    The GIL is released, so blocks can be compressed on several threads.
+    '''
+    ...
+
+def pybladerf_iq_decompress(data: Any, count: int, codec: pybladerf_iq_codec = pybladerf_iq_codec.PYBLADERF_IQ_CODEC_BFP, bits: int = 8, out: np.ndarray[Any, Any] | None = None) -> np.ndarray[Any, Any]:
+    '''
+    Decompress a block produced by pybladerf_iq_compress into `count` int16 values, `codec` and `bits` must match.
+    If `out` is given it must be a contiguous int16 array of at least `count` values; the returned array is a view of it.
+    '''
+    ...
+
+def pybladerf_simd_backend() -> str:
+    '''Vector instruction set the native kernels run with (avx2, sse2, neon or scalar). On x86 AVX2 is picked at run time when the CPU supports it'''
+    ...
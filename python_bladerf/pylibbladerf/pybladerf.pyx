@@ -24,23 +24,24 @@
 # cython: language_level = 3str
 # cython: freethreading_compatible = True
 from python_bladerf import __version__
-from libc.stdint cimport uint8_t, int16_t, uint16_t, int32_t, uint32_t, uint64_t, uintptr_t
+from libc.stdint cimport int8_t, uint8_t, int16_t, uint16_t, int32_t, uint32_t, uint64_t, uintptr_t
 from libc.string cimport memcpy, memset, strncpy
-from cpython cimport Py_INCREF, Py_DECREF
+from cpython cimport PyObject, Py_INCREF, Py_DECREF, Py_XINCREF, Py_XDECREF
 from typing import Any, Callable, Self
-from libc.stdlib cimport malloc, free
+from numbers import Integral
+from libc.stdlib cimport malloc, calloc, free
 from libcpp cimport bool as c_bool
 from enum import IntEnum
 from ctypes import c_int
 from . cimport cbladerf
+cimport numpy as cnp
 import numpy as np
 cimport cython
 
 IF ANDROID:
     from .__android import get_bladerf_device_list
 
-
-cdef dict global_callbacks = {}
+cnp.import_array()
 
 def PYBLADERF_CHANNEL_RX(channel: int) -> int:
     return (((channel) << 1) | 0x0)
@@ -83,9 +84,70 @@ cdef int PYMETADATA_FLAGS_SIZE = sizeof(uint32_t)
 cdef int PYMETADATA_TIMESTAMP_OFFSET = sizeof(uint32_t)
 cdef int PYMETADATA_FLAGS_OFFSET = PYMETADATA_TIMESTAMP_OFFSET + PYMETADATA_TIMESTAMP_SIZE
 cdef int PYMETADATA_HEADER_SIZE = PYMETADATA_FLAGS_OFFSET + PYMETADATA_FLAGS_SIZE
+cdef uint32_t PYMETADATA_FLAG_RX_HW_UNDERFLOW = (1 << 0)
+cdef uint32_t PYMETADATA_FLAG_RX_NOW = (1u << 31)
 cdef int USB_PACKAGE_SIZE_SS = 2048
 cdef int USB_PACKAGE_SIZE_HS = 1024
 
+# copies the payload of every usb package into one contiguous array, timestamps and flags go to parallel arrays
+@cython.boundscheck(False)
+@cython.wraparound(False)
+cdef size_t pybladerf_unpack_meta(pybladerf_async_data *async_data, const uint8_t *buffer, size_t num_packages, uint8_t *samples, uint64_t *timestamps, uint32_t *flags) noexcept nogil:
+    cdef size_t payload_bytes = async_data.package_size - PYMETADATA_HEADER_SIZE
+    cdef const uint8_t *package
+    cdef size_t i
+
+    for i in range(num_packages):
+        package = buffer + i * async_data.package_size
+        memcpy(&timestamps[i], package + PYMETADATA_TIMESTAMP_OFFSET, PYMETADATA_TIMESTAMP_SIZE)
+        memcpy(&flags[i], package + PYMETADATA_FLAGS_OFFSET, PYMETADATA_FLAGS_SIZE)
+        memcpy(samples + i * payload_bytes, package + PYMETADATA_HEADER_SIZE, payload_bytes)
+
+    return num_packages * async_data.samples_per_package
+
+@cython.boundscheck(False)
+@cython.wraparound(False)
+cdef void pybladerf_pack_meta(pybladerf_async_data *async_data, uint8_t *buffer, size_t num_packages, const uint8_t *samples, const uint64_t *timestamps, const uint32_t *flags) noexcept nogil:
+    cdef size_t payload_bytes = async_data.package_size - PYMETADATA_HEADER_SIZE
+    cdef uint8_t *package
+    cdef size_t i
+
+    for i in range(num_packages):
+        package = buffer + i * async_data.package_size
+        memset(package, 0, PYMETADATA_TIMESTAMP_OFFSET)
+        memcpy(package + PYMETADATA_TIMESTAMP_OFFSET, &timestamps[i], PYMETADATA_TIMESTAMP_SIZE)
+        memcpy(package + PYMETADATA_FLAGS_OFFSET, &flags[i], PYMETADATA_FLAGS_SIZE)
+        memcpy(package + PYMETADATA_HEADER_SIZE, samples + i * payload_bytes, payload_bytes)
+
+# rx only, a package whose timestamp does not follow the previous one is a discontinuity
+@cython.boundscheck(False)
+@cython.wraparound(False)
+cdef void pybladerf_count_meta(pybladerf_async_data *async_data, const uint64_t *timestamps, const uint32_t *flags, size_t num_packages) noexcept nogil:
+    cdef uint64_t discontinuities = 0
+    cdef uint64_t overruns = 0
+    cdef size_t i
+
+    for i in range(num_packages):
+        if async_data.has_timestamp and timestamps[i] != async_data.next_timestamp:
+            discontinuities += 1
+        if flags[i] & PYMETADATA_FLAG_RX_HW_UNDERFLOW:
+            overruns += 1
+
+        async_data.next_timestamp = timestamps[i] + async_data.samples_per_package
+        async_data.has_timestamp = True
+
+    if discontinuities:
+        async_data.discontinuities.fetch_add(discontinuities)
+    if overruns:
+        async_data.overruns.fetch_add(overruns)
+
+cdef inline size_t pybladerf_buffer_index(cbladerf.bladerf_stream *stream, void *buffer) noexcept nogil:
+    cdef size_t i
+    for i in range(stream.num_buffers):
+        if stream.buffers[i] == buffer:
+            return i
+    return stream.num_buffers
+
 # ---- ERROR ---- #
 class PYBLADERF_ERR(Exception):
     def __init__(self, message, code):
@@ -412,6 +474,21 @@ class pybladerf_sweep_style(IntEnum):
     def __str__(self) -> str:
         return self.name
 
+class pybladerf_sweep_drop_policy(IntEnum):
+    PYBLADERF_SWEEP_DROP_POLICY_BLOCK = 0
+    PYBLADERF_SWEEP_DROP_POLICY_DROP_NEWEST = 1
+    PYBLADERF_SWEEP_DROP_POLICY_DROP_OLDEST = 2
+
+    def __str__(self) -> str:
+        return self.name
+
+class pybladerf_iq_codec(IntEnum):
+    PYBLADERF_IQ_CODEC_BFP = 0
+    PYBLADERF_IQ_CODEC_LOSSLESS = 1
+
+    def __str__(self) -> str:
+        return self.name
+
 # ---- STRUCT ---- #
 cdef class pybladerf_devinfo:
 
@@ -980,11 +1057,40 @@ cdef class pybladerf_range:
     cdef const cbladerf.bladerf_range **get_double_ptr(self):
         return &self.__bladerf_range
 
+# waits for the callback to move a buffer, False once the stream ends or the timeout passes
+cdef c_bool pybladerf_stream_wait(cbladerf.bladerf_stream *stream, pybladerf_signal *signal, uint64_t seen, int timeout_ms, uint64_t deadline) noexcept nogil:
+    cdef uint64_t now = 0
+    cdef uint64_t wait_us = PYBLADERF_RING_WAIT_US
+
+    if stream.state == cbladerf.STREAM_SHUTTING_DOWN or stream.state == cbladerf.STREAM_DONE:
+        return False
+    if timeout_ms > 0:
+        now = pybladerf_monotonic_us()
+        if now >= deadline:
+            return False
+        wait_us = min(wait_us, deadline - now)
+
+    # the stream state changes without a notify, so the wait is bounded and the state checked again
+    pybladerf_signal_wait(signal, seen, wait_us)
+    return True
+
+
 cdef class pybladerf_stream:
 
+    def __cinit__(self):
+        self.buffer_states = NULL
+        self.buffer_views = []
+        self.meta_views = []
+        self.pending_submits = 0
+
     def __init__(self) -> None:
         self.idx = 0
 
+    def __dealloc__(self):
+        if self.buffer_states != NULL:
+            free(self.buffer_states)
+            self.buffer_states = NULL
+
     property layout:
         def __get__(self) -> pybladerf_channel_layout:
             if self.__bladerf_stream != NULL:
@@ -1020,14 +1126,338 @@ cdef class pybladerf_stream:
             if self.__bladerf_stream != NULL:
                 return cbladerf.bladerf_strerror(<size_t> self.__bladerf_stream.error_code).decode('utf-8')
 
-    cdef pybladerf_async_data get_async_data(self):
+    property leased_buffers:
+        def __get__(self) -> int:
+            cdef size_t leased = 0
+            cdef size_t i
+            if self.__bladerf_stream != NULL and self.buffer_states != NULL:
+                with self.buffer_lock:
+                    for i in range(self.__bladerf_stream.num_buffers):
+                        if self.buffer_states[i] == PYBLADERF_BUFFER_LEASED:
+                            leased += 1
+            return leased
+
+    def release_buffer(self, buffer: np.ndarray[Any, Any]) -> None:
+        cdef void *c_buffer = <void*> <uintptr_t> buffer.ctypes.data
+        cdef c_bool submit = False
+        cdef int result = 0
+        cdef int i = -1
+
+        if self.__bladerf_stream == NULL or self.buffer_states == NULL:
+            raise RuntimeError('release_buffer() failed: Stream is not in zero-copy mode!')
+
+        with self.buffer_lock:
+            for j in range(self.__bladerf_stream.num_buffers):
+                if self.__bladerf_stream.buffers[j] == c_buffer:
+                    i = j
+                    break
+
+            if i < 0 or self.buffer_states[i] != PYBLADERF_BUFFER_LEASED:
+                raise RuntimeError('release_buffer() failed: Buffer is not leased from this stream!')
+
+            # a callback that found no free buffer is waiting for this one
+            if self.pending_submits > 0:
+                self.pending_submits -= 1
+                self.buffer_states[i] = PYBLADERF_BUFFER_IN_FLIGHT
+                submit = True
+            else:
+                self.buffer_states[i] = PYBLADERF_BUFFER_FREE
+
+        if submit:
+            with nogil:
+                result = cbladerf.bladerf_submit_stream_buffer(self.__bladerf_stream, c_buffer, self.__bladerf_stream.transfer_timeout)
+            raise_error('release_buffer()', result)
+
+    property overflows:
+        def __get__(self) -> int:
+            cdef pybladerf_async_data *async_data = self.get_async_data()
+            if async_data != NULL:
+                return async_data.overflows.load()
+            return 0
+
+    property underflows:
+        def __get__(self) -> int:
+            cdef pybladerf_async_data *async_data = self.get_async_data()
+            if async_data != NULL:
+                return async_data.underflows.load()
+            return 0
+
+    property buffered:
+        def __get__(self) -> int:
+            cdef pybladerf_async_data *async_data = self.get_async_data()
+            if async_data != NULL and async_data.native:
+                return pybladerf_ring_size(&async_data.filled_ring)
+            return 0
+
+    property discontinuities:
+        def __get__(self) -> int:
+            cdef pybladerf_async_data *async_data = self.get_async_data()
+            if async_data != NULL:
+                return async_data.discontinuities.load()
+            return 0
+
+    property overruns:
+        def __get__(self) -> int:
+            cdef pybladerf_async_data *async_data = self.get_async_data()
+            if async_data != NULL:
+                return async_data.overruns.load()
+            return 0
+
+    def read(self, n_buffers: int, timeout_ms: int = 0) -> np.ndarray[Any, Any]:
+        cdef pybladerf_async_data *async_data = self.get_async_data()
+        if async_data == NULL or not async_data.native or async_data.tx_stream:
+            raise RuntimeError('read() failed: Stream is not a native rx stream!')
+        if async_data.meta:
+            raise RuntimeError('read() failed: Use read_meta() for meta formats!')
+
+        cdef cbladerf.bladerf_stream *c_stream = self.__bladerf_stream
+        cdef size_t c_n_buffers = <size_t> n_buffers
+        cdef size_t buffer_bytes = c_stream.samples_per_buffer * async_data.bytes_per_sample
+        cdef uint64_t deadline = pybladerf_monotonic_us() + <uint64_t> timeout_ms * 1000
+        cdef int c_timeout_ms = <int> timeout_ms
+        cdef uint64_t seen = 0
+        cdef c_bool popped = False
+        cdef size_t count = 0
+        cdef size_t idx
+
+        samples = np.empty(c_n_buffers * c_stream.samples_per_buffer * 2, dtype=np.int16 if async_data.bytes_per_sample == 4 else np.int8)
+        cdef uint8_t *samples_ptr = <uint8_t*> <uintptr_t> samples.ctypes.data
+
+        # the lock guards the consumer side of the rings for one buffer at a time, waiting happens without it
+        with nogil:
+            while count < c_n_buffers:
+                seen = pybladerf_signal_count(async_data.ring_signal)
+                with self.buffer_lock:
+                    popped = pybladerf_ring_pop(&async_data.filled_ring, &idx)
+                    if popped:
+                        memcpy(samples_ptr + count * buffer_bytes, c_stream.buffers[idx], buffer_bytes)
+                        pybladerf_ring_push(&async_data.free_ring, idx)
+                if popped:
+                    count += 1
+                    continue
+
+                if not pybladerf_stream_wait(c_stream, async_data.ring_signal, seen, c_timeout_ms, deadline):
+                    break
+
+        return samples[:count * c_stream.samples_per_buffer * 2]
+
+    def read_meta(self, n_buffers: int, timeout_ms: int = 0) -> tuple[np.ndarray[Any, Any], np.ndarray[Any, Any], np.ndarray[Any, Any]]:
+        cdef pybladerf_async_data *async_data = self.get_async_data()
+        if async_data == NULL or not async_data.native or async_data.tx_stream or not async_data.meta:
+            raise RuntimeError('read_meta() failed: Stream is not a native rx stream with meta format!')
+
+        cdef cbladerf.bladerf_stream *c_stream = self.__bladerf_stream
+        cdef size_t c_n_buffers = <size_t> n_buffers
+        cdef size_t num_packages = <size_t> async_data.packages_per_buffer
+        cdef size_t payload_bytes = num_packages * async_data.samples_per_package * async_data.bytes_per_sample
+        cdef uint64_t deadline = pybladerf_monotonic_us() + <uint64_t> timeout_ms * 1000
+        cdef int c_timeout_ms = <int> timeout_ms
+        cdef uint64_t seen = 0
+        cdef c_bool popped = False
+        cdef size_t count = 0
+        cdef size_t idx
+
+        samples = np.empty(c_n_buffers * num_packages * async_data.samples_per_package * 2, dtype=np.int16 if async_data.bytes_per_sample == 4 else np.int8)
+        timestamps = np.empty(c_n_buffers * num_packages, dtype=np.uint64)
+        flags = np.empty(c_n_buffers * num_packages, dtype=np.uint32)
+        cdef uint8_t *samples_ptr = <uint8_t*> <uintptr_t> samples.ctypes.data
+        cdef uint64_t *timestamps_ptr = <uint64_t*> <uintptr_t> timestamps.ctypes.data
+        cdef uint32_t *flags_ptr = <uint32_t*> <uintptr_t> flags.ctypes.data
+
+        with nogil:
+            while count < c_n_buffers:
+                seen = pybladerf_signal_count(async_data.ring_signal)
+                with self.buffer_lock:
+                    popped = pybladerf_ring_pop(&async_data.filled_ring, &idx)
+                    if popped:
+                        pybladerf_unpack_meta(async_data, <uint8_t*> c_stream.buffers[idx], num_packages, samples_ptr + count * payload_bytes, timestamps_ptr + count * num_packages, flags_ptr + count * num_packages)
+                        pybladerf_ring_push(&async_data.free_ring, idx)
+                        pybladerf_count_meta(async_data, timestamps_ptr + count * num_packages, flags_ptr + count * num_packages, num_packages)
+                if popped:
+                    count += 1
+                    continue
+
+                if not pybladerf_stream_wait(c_stream, async_data.ring_signal, seen, c_timeout_ms, deadline):
+                    break
+
+        return samples[:count * num_packages * async_data.samples_per_package * 2], timestamps[:count * num_packages], flags[:count * num_packages]
+
+    def write(self, samples: np.ndarray[Any, Any], timeout_ms: int = 0) -> int:
+        cdef pybladerf_async_data *async_data = self.get_async_data()
+        if async_data == NULL or not async_data.native or not async_data.tx_stream:
+            raise RuntimeError('write() failed: Stream is not a native tx stream!')
+
+        cdef cbladerf.bladerf_stream *c_stream = self.__bladerf_stream
+        cdef size_t buffer_bytes = c_stream.samples_per_buffer * async_data.bytes_per_sample
+        cdef uint64_t deadline = pybladerf_monotonic_us() + <uint64_t> timeout_ms * 1000
+        cdef int c_timeout_ms = <int> timeout_ms
+        cdef uint64_t seen = 0
+        cdef c_bool popped = False
+        cdef size_t count = 0
+        cdef size_t chunk_bytes
+        cdef size_t idx
+
+        samples = np.ascontiguousarray(samples, dtype=np.int16 if async_data.bytes_per_sample == 4 else np.int8)
+        cdef uint8_t *samples_ptr = <uint8_t*> <uintptr_t> samples.ctypes.data
+        cdef size_t total_bytes = <size_t> samples.nbytes
+        cdef size_t n_buffers = (total_bytes + buffer_bytes - 1) // buffer_bytes
+
+        with nogil:
+            while count < n_buffers:
+                seen = pybladerf_signal_count(async_data.ring_signal)
+                with self.buffer_lock:
+                    popped = pybladerf_ring_pop(&async_data.free_ring, &idx)
+                    if popped:
+                        chunk_bytes = min(buffer_bytes, total_bytes - count * buffer_bytes)
+                        memcpy(c_stream.buffers[idx], samples_ptr + count * buffer_bytes, chunk_bytes)
+                        if chunk_bytes < buffer_bytes:
+                            memset(<uint8_t*> c_stream.buffers[idx] + chunk_bytes, 0, buffer_bytes - chunk_bytes)
+                        pybladerf_ring_push(&async_data.filled_ring, idx)
+                if popped:
+                    count += 1
+                    continue
+
+                if not pybladerf_stream_wait(c_stream, async_data.ring_signal, seen, c_timeout_ms, deadline):
+                    break
+
+        return min(count * buffer_bytes, total_bytes) // async_data.bytes_per_sample
+
+    def request_shutdown(self) -> None:
+        cdef pybladerf_async_data *async_data = self.get_async_data()
+        if async_data != NULL:
+            async_data.shutdown_requested.store(True)
+            if async_data.ring_signal != NULL:
+                pybladerf_signal_notify(async_data.ring_signal)
+
+    cdef pybladerf_async_data *get_async_data(self):
         if self.__bladerf_stream != NULL:
-            return (<pybladerf_async_data*> self.__bladerf_stream.user_data)[0]
+            return <pybladerf_async_data*> self.__bladerf_stream.user_data
+        return NULL
 
     cdef void *get_next_buffer_ptr(self):
         self.idx = (self.idx + 1) % self.num_buffers
         return self.__bladerf_stream.buffers[self.idx]
 
+    cdef int _init_buffer_views(self, object dtype, size_t num_transfers, c_bool writeable) except -1:
+        cdef size_t num_buffers = self.__bladerf_stream.num_buffers
+        cdef cnp.npy_intp shape = self.__bladerf_stream.samples_per_buffer * 2
+        cdef int typenum = cnp.dtype(dtype).num
+        cdef cnp.ndarray view
+        cdef size_t i
+
+        self.buffer_states = <uint8_t*> malloc(num_buffers * sizeof(uint8_t))
+        if self.buffer_states == NULL:
+            raise MemoryError('Failed to allocate zero-copy buffer states')
+        self.buffer_views = []
+
+        # libbladeRF submits the first num_transfers buffers when the stream starts
+        for i in range(num_buffers):
+            self.buffer_states[i] = PYBLADERF_BUFFER_IN_FLIGHT if i < num_transfers else PYBLADERF_BUFFER_FREE
+
+            view = cnp.PyArray_SimpleNewFromData(1, &shape, typenum, self.__bladerf_stream.buffers[i])
+            if not writeable:
+                cnp.PyArray_CLEARFLAGS(view, cnp.NPY_ARRAY_WRITEABLE)
+            self.buffer_views.append(view)
+
+        self.idx = <int> (num_transfers % num_buffers)
+        return 0
+
+    cdef int _init_meta_views(self) except -1:
+        cdef pybladerf_async_data *async_data = self.get_async_data()
+        cdef size_t payload_samples = async_data.packages_per_buffer * async_data.samples_per_package
+        cdef object dtype = np.int16 if async_data.bytes_per_sample == 4 else np.int8
+
+        # one set of payload, timestamps and flags per stream buffer, so the callbacks allocate nothing
+        self.meta_views = [
+            (np.zeros(payload_samples * 2, dtype=dtype), np.zeros(async_data.packages_per_buffer, dtype=np.uint64), np.zeros(async_data.packages_per_buffer, dtype=np.uint32))
+            for _ in range(self.__bladerf_stream.num_buffers)
+        ]
+        return 0
+
+    cdef int _init_native_rings(self, size_t num_transfers) except -1:
+        cdef pybladerf_async_data *async_data = self.get_async_data()
+        cdef size_t num_buffers = self.__bladerf_stream.num_buffers
+        cdef size_t buffer_bytes = self.__bladerf_stream.samples_per_buffer * async_data.bytes_per_sample
+        cdef size_t i
+
+        async_data.filled_ring.slots = <size_t*> malloc(num_buffers * sizeof(size_t))
+        async_data.filled_ring.capacity = num_buffers
+        async_data.free_ring.slots = <size_t*> malloc(num_buffers * sizeof(size_t))
+        async_data.free_ring.capacity = num_buffers
+        async_data.ring_signal = pybladerf_signal_new()
+        if async_data.filled_ring.slots == NULL or async_data.free_ring.slots == NULL:
+            raise MemoryError('Failed to allocate native stream rings')
+
+        if async_data.tx_stream:
+            # the last buffer is kept zeroed and transmitted whenever the user falls behind
+            async_data.silence_buffer = self.__bladerf_stream.buffers[num_buffers - 1]
+            memset(async_data.silence_buffer, 0, buffer_bytes)
+            for i in range(num_buffers - 1):
+                pybladerf_ring_push(&async_data.free_ring, i)
+        else:
+            # libbladeRF submits the first num_transfers buffers when the stream starts
+            for i in range(num_transfers, num_buffers):
+                pybladerf_ring_push(&async_data.free_ring, i)
+        return 0
+
+    cdef int _deinit(self) except -1:
+        cdef pybladerf_async_data *async_data = self.get_async_data()
+        if self.__bladerf_stream == NULL:
+            return 0
+
+        # leased views point straight into the stream buffers, freeing them now would leave the views dangling
+        if self.leased_buffers > 0:
+            raise RuntimeError('pybladerf_deinit_stream() failed: Release all leased buffers before deinitializing the stream!')
+
+        cbladerf.bladerf_deinit_stream(self.__bladerf_stream)
+        self.__bladerf_stream = NULL
+        self.buffer_views = []
+        self.meta_views = []
+
+        if async_data != NULL:
+            Py_XDECREF(async_data.device)
+            Py_XDECREF(async_data.callback)
+            Py_XDECREF(async_data.complete_callback)
+            Py_XDECREF(async_data.valid_num_samples)
+            free(async_data.filled_ring.slots)
+            free(async_data.free_ring.slots)
+            if async_data.ring_signal != NULL:
+                pybladerf_signal_free(async_data.ring_signal)
+            free(async_data)
+        return 0
+
+    cdef int lease_buffer(self, void *buffer):
+        return self.set_buffer_state(buffer, PYBLADERF_BUFFER_LEASED)
+
+    cdef int set_buffer_state(self, void *buffer, uint8_t state):
+        cdef size_t num_buffers = self.__bladerf_stream.num_buffers
+        cdef size_t i
+
+        with self.buffer_lock:
+            for i in range(num_buffers):
+                if self.__bladerf_stream.buffers[i] == buffer:
+                    self.buffer_states[i] = state
+                    return <int> i
+        return -1
+
+    cdef void *get_free_buffer_ptr(self):
+        cdef size_t num_buffers = self.__bladerf_stream.num_buffers
+        cdef size_t i, j
+
+        with self.buffer_lock:
+            for i in range(num_buffers):
+                j = (self.idx + i) % num_buffers
+                if self.buffer_states[j] == PYBLADERF_BUFFER_FREE:
+                    self.buffer_states[j] = PYBLADERF_BUFFER_IN_FLIGHT
+                    self.idx = <int> ((j + 1) % num_buffers)
+                    return self.__bladerf_stream.buffers[j]
+
+            # every buffer is leased or in flight, release_buffer() will submit the next one
+            # tx buffers are never leased, the next tx callback picks up a free buffer itself
+            if not self.get_async_data().tx_stream:
+                self.pending_submits += 1
+        return PYBLADERF_STREAM_NO_DATA
+
     cdef cbladerf.bladerf_stream *get_ptr(self):
         return self.__bladerf_stream
 
@@ -1130,7 +1560,6 @@ ELSE:
 @cython.boundscheck(False)
 @cython.wraparound(False)
 cdef void *__rx_callback_SC16_Q11(cbladerf.bladerf *dev, cbladerf.bladerf_stream *stream, cbladerf.bladerf_metadata *meta, void *samples, size_t num_samples, void *user_data) noexcept nogil:
-    global global_callbacks
     cdef pybladerf_async_data *async_data = <pybladerf_async_data*> user_data
     cdef uint8_t *buffer_ptr = <uint8_t*> samples
     cdef uint8_t *np_buffer_ptr
@@ -1147,8 +1576,8 @@ cdef void *__rx_callback_SC16_Q11(cbladerf.bladerf *dev, cbladerf.bladerf_stream
             num_samples * async_data.bytes_per_sample,
         )
 
-        if global_callbacks[<size_t> dev]['__rx_callback'] is not None:
-            result = global_callbacks[<size_t> dev]['__rx_callback'](global_callbacks[<size_t> dev]['device'], pystream, np_buffer, num_samples)
+        if async_data.callback != NULL:
+            result = (<object> async_data.callback)(<object> async_data.device, pystream, np_buffer, num_samples)
 
         if result == 0:
             return pystream.get_next_buffer_ptr()
@@ -1159,7 +1588,6 @@ cdef void *__rx_callback_SC16_Q11(cbladerf.bladerf *dev, cbladerf.bladerf_stream
 @cython.boundscheck(False)
 @cython.wraparound(False)
 cdef void *__rx_callback_SC8_Q7(cbladerf.bladerf *dev, cbladerf.bladerf_stream *stream, cbladerf.bladerf_metadata *meta, void *samples, size_t num_samples, void *user_data) noexcept nogil:
-    global global_callbacks
     cdef pybladerf_async_data *async_data = <pybladerf_async_data*> user_data
     cdef uint8_t *buffer_ptr = <uint8_t*> samples
     cdef uint8_t *np_buffer_ptr
@@ -1176,8 +1604,39 @@ cdef void *__rx_callback_SC8_Q7(cbladerf.bladerf *dev, cbladerf.bladerf_stream *
             num_samples * async_data.bytes_per_sample,
         )
 
-        if global_callbacks[<size_t> dev]['__rx_callback'] is not None:
-            result = global_callbacks[<size_t> dev]['__rx_callback'](global_callbacks[<size_t> dev]['device'], pystream, np_buffer, num_samples)
+        if async_data.callback != NULL:
+            result = (<object> async_data.callback)(<object> async_data.device, pystream, np_buffer, num_samples)
+
+        if result == 0:
+            return pystream.get_next_buffer_ptr()
+
+        return PYBLADERF_STREAM_SHUTDOWN
+
+
+@cython.boundscheck(False)
+@cython.wraparound(False)
+cdef void *__rx_callback_meta(cbladerf.bladerf *dev, cbladerf.bladerf_stream *stream, cbladerf.bladerf_metadata *meta, void *samples, size_t num_samples, void *user_data) noexcept nogil:
+    cdef pybladerf_async_data *async_data = <pybladerf_async_data*> user_data
+    cdef size_t num_packages = num_samples * async_data.bytes_per_sample // async_data.package_size
+    cdef size_t payload_samples = num_packages * async_data.samples_per_package
+    cdef cnp.ndarray np_buffer, timestamps, flags
+    cdef uint64_t *timestamps_ptr
+    cdef uint32_t *flags_ptr
+    cdef int result = 0
+
+    with gil:
+        pystream = <pybladerf_stream> async_data.pystream
+
+        # the arrays belong to this stream buffer and are refilled when it comes round again
+        np_buffer, timestamps, flags = pystream.meta_views[pybladerf_buffer_index(stream, samples)]
+        timestamps_ptr = <uint64_t*> cnp.PyArray_DATA(timestamps)
+        flags_ptr = <uint32_t*> cnp.PyArray_DATA(flags)
+
+        pybladerf_unpack_meta(async_data, <uint8_t*> samples, num_packages, <uint8_t*> cnp.PyArray_DATA(np_buffer), timestamps_ptr, flags_ptr)
+        pybladerf_count_meta(async_data, timestamps_ptr, flags_ptr, num_packages)
+
+        if async_data.callback != NULL:
+            result = (<object> async_data.callback)(<object> async_data.device, pystream, np_buffer, payload_samples, timestamps, flags)
 
         if result == 0:
             return pystream.get_next_buffer_ptr()
@@ -1185,15 +1644,122 @@ cdef void *__rx_callback_SC8_Q7(cbladerf.bladerf *dev, cbladerf.bladerf_stream *
         return PYBLADERF_STREAM_SHUTDOWN
 
 
+@cython.boundscheck(False)
+@cython.wraparound(False)
+cdef void *__rx_callback_zero_copy(cbladerf.bladerf *dev, cbladerf.bladerf_stream *stream, cbladerf.bladerf_metadata *meta, void *samples, size_t num_samples, void *user_data) noexcept nogil:
+    cdef pybladerf_async_data *async_data = <pybladerf_async_data*> user_data
+    cdef int buffer_idx
+    cdef int result = 0
+
+    with gil:
+        pystream = <pybladerf_stream> async_data.pystream
+
+        buffer_idx = pystream.lease_buffer(samples)
+        if buffer_idx < 0:
+            return PYBLADERF_STREAM_SHUTDOWN
+
+        if async_data.callback != NULL:
+            result = (<object> async_data.callback)(<object> async_data.device, pystream, pystream.buffer_views[buffer_idx], num_samples)
+
+        if result == 0:
+            return pystream.get_free_buffer_ptr()
+
+        return PYBLADERF_STREAM_SHUTDOWN
+
+
+@cython.boundscheck(False)
+@cython.wraparound(False)
+cdef void *__rx_callback_native(cbladerf.bladerf *dev, cbladerf.bladerf_stream *stream, cbladerf.bladerf_metadata *meta, void *samples, size_t num_samples, void *user_data) noexcept nogil:
+    cdef pybladerf_async_data *async_data = <pybladerf_async_data*> user_data
+    cdef size_t next_idx
+
+    if async_data.shutdown_requested.load():
+        return PYBLADERF_STREAM_SHUTDOWN
+
+    if pybladerf_ring_pop(&async_data.free_ring, &next_idx):
+        pybladerf_ring_push(&async_data.filled_ring, pybladerf_buffer_index(stream, samples))
+        pybladerf_signal_notify(async_data.ring_signal)
+        return stream.buffers[next_idx]
+
+    # the consumer fell behind, drop this buffer and receive into it again
+    async_data.overflows.fetch_add(1)
+    return samples
+
+
+@cython.boundscheck(False)
+@cython.wraparound(False)
+cdef void *__tx_callback_zero_copy(cbladerf.bladerf *dev, cbladerf.bladerf_stream *stream, cbladerf.bladerf_metadata *meta, void *samples, size_t num_samples, void *user_data) noexcept nogil:
+    cdef pybladerf_async_data *async_data = <pybladerf_async_data*> user_data
+    cdef void *buffer_ptr
+    cdef int buffer_idx
+    cdef int valid_length
+    cdef int result = 0
+
+    with gil:
+        pystream = <pybladerf_stream> async_data.pystream
+
+        # the transmitted buffer goes back to the pool, the complete callback sees it in place
+        if samples != NULL:
+            buffer_idx = pystream.set_buffer_state(samples, PYBLADERF_BUFFER_FREE)
+            if async_data.complete_callback != NULL and async_data.tx_complete and buffer_idx >= 0:
+                (<object> async_data.complete_callback)(<object> async_data.device, pystream, pystream.buffer_views[buffer_idx], num_samples)
+
+        buffer_ptr = pystream.get_free_buffer_ptr()
+        if buffer_ptr == PYBLADERF_STREAM_NO_DATA:
+            return PYBLADERF_STREAM_NO_DATA
+
+        buffer_idx = pybladerf_buffer_index(stream, buffer_ptr)
+        valid_num_samples = <object> async_data.valid_num_samples
+        valid_num_samples.value = num_samples
+
+        if async_data.callback != NULL:
+            result = (<object> async_data.callback)(<object> async_data.device, pystream, pystream.buffer_views[buffer_idx], num_samples, valid_num_samples)
+
+        valid_length = min(<int> num_samples, max(0, <int> valid_num_samples.value))
+
+    if result == 0:
+        if <size_t> valid_length < num_samples:
+            memset(<uint8_t*> buffer_ptr + valid_length * async_data.bytes_per_sample, 0, (num_samples - valid_length) * async_data.bytes_per_sample)
+        return buffer_ptr
+
+    # nothing is submitted, hand the buffer back to the pool
+    with gil:
+        pystream.set_buffer_state(buffer_ptr, PYBLADERF_BUFFER_FREE)
+
+    if result == 1:
+        return PYBLADERF_STREAM_NO_DATA
+    return PYBLADERF_STREAM_SHUTDOWN
+
+
+@cython.boundscheck(False)
+@cython.wraparound(False)
+cdef void *__tx_callback_native(cbladerf.bladerf *dev, cbladerf.bladerf_stream *stream, cbladerf.bladerf_metadata *meta, void *samples, size_t num_samples, void *user_data) noexcept nogil:
+    cdef pybladerf_async_data *async_data = <pybladerf_async_data*> user_data
+    cdef size_t next_idx
+
+    if samples != NULL and samples != async_data.silence_buffer:
+        pybladerf_ring_push(&async_data.free_ring, pybladerf_buffer_index(stream, samples))
+        pybladerf_signal_notify(async_data.ring_signal)
+
+    if async_data.shutdown_requested.load():
+        return PYBLADERF_STREAM_SHUTDOWN
+
+    if pybladerf_ring_pop(&async_data.filled_ring, &next_idx):
+        return stream.buffers[next_idx]
+
+    # the producer fell behind, keep the link busy with zeros
+    async_data.underflows.fetch_add(1)
+    return async_data.silence_buffer
+
+
 @cython.boundscheck(False)
 @cython.wraparound(False)
 cdef void *__tx_callback_SC16_Q11(cbladerf.bladerf *dev, cbladerf.bladerf_stream *stream, cbladerf.bladerf_metadata *meta, void *samples, size_t num_samples, void *user_data) noexcept nogil:
-    global global_callbacks
     cdef pybladerf_async_data *async_data = <pybladerf_async_data*> user_data
     cdef uint8_t *np_buffer_ptr
     cdef uint8_t *buffer_ptr
     cdef int valid_length
-    cdef int result
+    cdef int result = 0
 
     if samples != NULL:
         __tx_complete_callback_SC16_Q11(dev, stream, meta, samples, num_samples, user_data)
@@ -1204,10 +1770,11 @@ cdef void *__tx_callback_SC16_Q11(cbladerf.bladerf *dev, cbladerf.bladerf_stream
 
         np_buffer = np.zeros(num_samples * 2, dtype=np.int16)
         np_buffer_ptr = <uint8_t*> <uintptr_t> np_buffer.ctypes.data
-        valid_num_samples = c_int(num_samples)
+        valid_num_samples = <object> async_data.valid_num_samples
+        valid_num_samples.value = num_samples
 
-        if global_callbacks[<size_t> dev]['__tx_callback'] is not None:
-            result = global_callbacks[<size_t> dev]['__tx_callback'](global_callbacks[<size_t> dev]['device'], pystream, np_buffer, num_samples, valid_num_samples)
+        if async_data.callback != NULL:
+            result = (<object> async_data.callback)(<object> async_data.device, pystream, np_buffer, num_samples, valid_num_samples)
 
         valid_length = valid_num_samples.value
 
@@ -1228,12 +1795,11 @@ cdef void *__tx_callback_SC16_Q11(cbladerf.bladerf *dev, cbladerf.bladerf_stream
 @cython.boundscheck(False)
 @cython.wraparound(False)
 cdef void *__tx_callback_SC8_Q7(cbladerf.bladerf *dev, cbladerf.bladerf_stream *stream, cbladerf.bladerf_metadata *meta, void *samples, size_t num_samples, void *user_data) noexcept nogil:
-    global global_callbacks
     cdef pybladerf_async_data *async_data = <pybladerf_async_data*> user_data
     cdef uint8_t *np_buffer_ptr
     cdef uint8_t *buffer_ptr
     cdef int valid_length
-    cdef int result
+    cdef int result = 0
 
     if samples != NULL:
         __tx_complete_callback_SC8_Q7(dev, stream, meta, samples, num_samples, user_data)
@@ -1245,10 +1811,11 @@ cdef void *__tx_callback_SC8_Q7(cbladerf.bladerf *dev, cbladerf.bladerf_stream *
         buffer_size = num_samples * 2
         np_buffer = np.zeros(buffer_size, dtype=np.int8)
         np_buffer_ptr = <uint8_t*> <uintptr_t> np_buffer.ctypes.data
-        valid_num_samples = c_int(num_samples)
+        valid_num_samples = <object> async_data.valid_num_samples
+        valid_num_samples.value = num_samples
 
-        if global_callbacks[<size_t> dev]['__tx_callback'] is not None:
-            result = global_callbacks[<size_t> dev]['__tx_callback'](global_callbacks[<size_t> dev]['device'], pystream, np_buffer, num_samples, valid_num_samples)
+        if async_data.callback != NULL:
+            result = (<object> async_data.callback)(<object> async_data.device, pystream, np_buffer, num_samples, valid_num_samples)
 
         valid_length = valid_num_samples.value
 
@@ -1266,14 +1833,87 @@ cdef void *__tx_callback_SC8_Q7(cbladerf.bladerf *dev, cbladerf.bladerf_stream *
     return PYBLADERF_STREAM_SHUTDOWN
 
 
+@cython.boundscheck(False)
+@cython.wraparound(False)
+cdef void *__tx_callback_meta(cbladerf.bladerf *dev, cbladerf.bladerf_stream *stream, cbladerf.bladerf_metadata *meta, void *samples, size_t num_samples, void *user_data) noexcept nogil:
+    cdef pybladerf_async_data *async_data = <pybladerf_async_data*> user_data
+    cdef size_t num_packages = num_samples * async_data.bytes_per_sample // async_data.package_size
+    cdef size_t payload_samples = num_packages * async_data.samples_per_package
+    cdef cnp.ndarray np_buffer, timestamps, flags
+    cdef uint8_t *buffer_ptr
+    cdef int result = 0
+
+    if samples != NULL:
+        __tx_complete_callback_meta(dev, stream, meta, samples, num_samples, user_data)
+
+    with gil:
+        pystream = <pybladerf_stream> async_data.pystream
+        buffer_ptr = <uint8_t*> pystream.get_next_buffer_ptr()
+
+        # the payload still holds what this stream buffer transmitted last time, timestamps and flags start cleared
+        np_buffer, timestamps, flags = pystream.meta_views[pybladerf_buffer_index(stream, buffer_ptr)]
+        memset(cnp.PyArray_DATA(timestamps), 0, num_packages * sizeof(uint64_t))
+        memset(cnp.PyArray_DATA(flags), 0, num_packages * sizeof(uint32_t))
+        valid_num_samples = <object> async_data.valid_num_samples
+        valid_num_samples.value = payload_samples
+
+        if async_data.callback != NULL:
+            result = (<object> async_data.callback)(<object> async_data.device, pystream, np_buffer, payload_samples, valid_num_samples, timestamps, flags)
+
+        if result == 0:
+            np_buffer[valid_num_samples.value * 2:] = 0
+            pybladerf_pack_meta(
+                async_data,
+                buffer_ptr,
+                num_packages,
+                <uint8_t*> cnp.PyArray_DATA(np_buffer),
+                <uint64_t*> cnp.PyArray_DATA(timestamps),
+                <uint32_t*> cnp.PyArray_DATA(flags),
+            )
+            return <void*> buffer_ptr
+
+    if result == 1:
+        return PYBLADERF_STREAM_NO_DATA
+
+    return PYBLADERF_STREAM_SHUTDOWN
+
+
+@cython.boundscheck(False)
+@cython.wraparound(False)
+cdef void __tx_complete_callback_meta(cbladerf.bladerf *dev, cbladerf.bladerf_stream *stream, cbladerf.bladerf_metadata *meta, void *samples, size_t num_samples, void *user_data) noexcept nogil:
+    cdef pybladerf_async_data *async_data = <pybladerf_async_data*> user_data
+    cdef size_t num_packages = num_samples * async_data.bytes_per_sample // async_data.package_size
+    cdef size_t payload_samples = num_packages * async_data.samples_per_package
+    cdef cnp.ndarray np_buffer, timestamps, flags
+
+    if async_data.complete_callback == NULL or not async_data.tx_complete:
+        return
+
+    with gil:
+        pystream = <pybladerf_stream> async_data.pystream
+
+        np_buffer, timestamps, flags = pystream.meta_views[pybladerf_buffer_index(stream, samples)]
+        pybladerf_unpack_meta(
+            async_data,
+            <uint8_t*> samples,
+            num_packages,
+            <uint8_t*> cnp.PyArray_DATA(np_buffer),
+            <uint64_t*> cnp.PyArray_DATA(timestamps),
+            <uint32_t*> cnp.PyArray_DATA(flags),
+        )
+        (<object> async_data.complete_callback)(<object> async_data.device, pystream, np_buffer, payload_samples)
+
+
 @cython.boundscheck(False)
 @cython.wraparound(False)
 cdef void __tx_complete_callback_SC16_Q11(cbladerf.bladerf *dev, cbladerf.bladerf_stream *stream, cbladerf.bladerf_metadata *meta, void *samples, size_t num_samples, void *user_data) noexcept nogil:
-    global global_callbacks
     cdef pybladerf_async_data *async_data = <pybladerf_async_data*> user_data
     cdef uint8_t *buffer_ptr = <uint8_t*> samples
     cdef uint8_t *np_buffer_ptr
 
+    if async_data.complete_callback == NULL or not async_data.tx_complete:
+        return
+
     with gil:
         pystream = <pybladerf_stream> async_data.pystream
 
@@ -1286,18 +1926,19 @@ cdef void __tx_complete_callback_SC16_Q11(cbladerf.bladerf *dev, cbladerf.blader
             num_samples * async_data.bytes_per_sample,
         )
 
-        if global_callbacks[<size_t> dev]['__tx_complete_callback'] is not None and global_callbacks[<size_t> dev]['tx_complete_enabled']:
-            global_callbacks[<size_t> dev]['__tx_complete_callback'](global_callbacks[<size_t> dev]['device'], pystream, np_buffer, num_samples)
+        (<object> async_data.complete_callback)(<object> async_data.device, pystream, np_buffer, num_samples)
 
 
 @cython.boundscheck(False)
 @cython.wraparound(False)
 cdef void __tx_complete_callback_SC8_Q7(cbladerf.bladerf *dev, cbladerf.bladerf_stream *stream, cbladerf.bladerf_metadata *meta, void *samples, size_t num_samples, void *user_data) noexcept nogil:
-    global global_callbacks
     cdef pybladerf_async_data *async_data = <pybladerf_async_data*> user_data
     cdef uint8_t *buffer_ptr = <uint8_t*> samples
     cdef uint8_t *np_buffer_ptr
 
+    if async_data.complete_callback == NULL or not async_data.tx_complete:
+        return
+
     with gil:
         pystream = <pybladerf_stream> async_data.pystream
 
@@ -1310,22 +1951,351 @@ cdef void __tx_complete_callback_SC8_Q7(cbladerf.bladerf *dev, cbladerf.bladerf_
             num_samples * async_data.bytes_per_sample,
         )
 
-        if global_callbacks[<size_t> dev]['__tx_complete_callback'] is not None and global_callbacks[<size_t> dev]['tx_complete_enabled']:
-            global_callbacks[<size_t> dev]['__tx_complete_callback'](global_callbacks[<size_t> dev]['device'], pystream, np_buffer, num_samples)
+        (<object> async_data.complete_callback)(<object> async_data.device, pystream, np_buffer, num_samples)
+
+
+cdef class pybladerf_iq_stats:
+
+    def __cinit__(self):
+        self.__stats = pybladerf_iq_stats_new()
+
+    def __init__(self, oversample: bool = False, histogram: bool = False) -> None:
+        self.oversample = oversample
+        self.clip_level = 127 if oversample else 2047
+        self.hist_shift = (1 if oversample else 5) if histogram else -1
+
+    def __dealloc__(self):
+        if self.__stats != NULL:
+            pybladerf_iq_stats_free(self.__stats)
+            self.__stats = NULL
+
+    cdef void update_ptr(self, const void *samples, size_t num_samples) noexcept nogil:
+        cdef pybladerf_iq_stats_acc acc
+        pybladerf_iq_stats_clear(&acc)
+        if self.oversample:
+            pybladerf_iq_stats_update[int8_t](<const int8_t*> samples, num_samples, self.clip_level, self.hist_shift, &acc)
+        else:
+            pybladerf_iq_stats_update[int16_t](<const int16_t*> samples, num_samples, self.clip_level, self.hist_shift, &acc)
+        pybladerf_iq_stats_publish(self.__stats, &acc)
+
+    def update(self, samples: np.ndarray[Any, Any], num_samples: int | None = None) -> None:
+        cdef cnp.ndarray c_samples = np.ascontiguousarray(samples, dtype=np.int8 if self.oversample else np.int16).reshape(-1)
+        cdef size_t c_num_samples = c_samples.size // 2 if num_samples is None else min(<size_t> num_samples, c_samples.size // 2)
+        cdef const void *samples_ptr = cnp.PyArray_DATA(c_samples)
+        with nogil:
+            self.update_ptr(samples_ptr, c_num_samples)
+
+    def snapshot(self, reset: bool = True) -> dict[str, Any]:
+        cdef pybladerf_iq_stats_acc acc
+        cdef int c_reset = 1 if reset else 0
+        with nogil:
+            pybladerf_iq_stats_take(self.__stats, &acc, c_reset)
+
+        cdef double max_power = <double> self.clip_level * self.clip_level
+        cdef double full_scale = 128.0 if self.oversample else 2048.0
+        return {
+            'samples': acc.samples,
+            'power_dbfs': 10 * np.log10(acc.power / (acc.samples * max_power)) if acc.power else -np.inf,
+            'peak_dbfs': 10 * np.log10(acc.peak / max_power) if acc.peak else -np.inf,
+            'clipped': acc.clipped,
+            'clipped_ratio': acc.clipped / acc.samples if acc.samples else 0.0,
+            'dc_i': acc.sum_i / (acc.samples * full_scale) if acc.samples else 0.0,
+            'dc_q': acc.sum_q / (acc.samples * full_scale) if acc.samples else 0.0,
+            'histogram': np.array([acc.histogram[i] for i in range(PYBLADERF_IQ_HIST_BINS)], dtype=np.uint64) if self.hist_shift >= 0 else None,
+        }
+
+
+cdef int pybladerf_hop_schedule(pybladerf_hop_plan *plan) noexcept nogil:
+    cdef uint16_t hop = plan.order[plan.position]
+    cdef pybladerf_hop_step *step = &plan.steps[plan.write_ptr]
+    cdef int result
+
+    plan.quick_tunes[hop].rffe_profile = plan.free_rffe_profile
+    result = cbladerf.bladerf_schedule_retune(plan.device, plan.channel, plan.schedule_timestamp, 0, &plan.quick_tunes[hop])
+    if result < 0:
+        return result
+
+    step.frequency = plan.frequencies[hop]
+    step.schedule_time = plan.schedule_timestamp + plan.settle_times[hop]
+    step.dwell = plan.dwells[hop]
+    step.position = plan.position
+    step.hop = hop
+    step.recovering = plan.recovering > 0
+    if plan.recovering:
+        plan.recovering -= 1
+
+    plan.write_ptr = (plan.write_ptr + 1) % PYBLADERF_HOP_MAX_LOOKAHEAD
+    plan.in_flight += 1
+    plan.free_rffe_profile = (plan.free_rffe_profile + 1) % plan.rffe_profiles
+    plan.schedule_timestamp += plan.settle_times[hop] + plan.dwells[hop]
+    plan.position = (plan.position + 1) % plan.order_len
+    return 0
+
+
+cdef int pybladerf_hop_restart(pybladerf_hop_plan *plan, uint32_t position, uint64_t lead) noexcept nogil:
+    cdef int result
+
+    plan.position = position
+    plan.read_ptr = 0
+    plan.write_ptr = 0
+    plan.in_flight = 0
+    plan.free_rffe_profile = 0
+
+    result = cbladerf.bladerf_get_timestamp(plan.device, cbladerf.BLADERF_RX, &plan.schedule_timestamp)
+    if result < 0:
+        return result
+    plan.schedule_timestamp += lead
+    return pybladerf_hop_fill(plan)
+
+
+cdef int pybladerf_hop_start(pybladerf_hop_plan *plan) noexcept nogil:
+    plan.lookahead = plan.min_lookahead
+    plan.recovery_lead = plan.min_recovery_lead
+    plan.recovering = 0
+    plan.stable_hops = 0
+    return pybladerf_hop_restart(plan, 0, plan.start_lead)
+
+
+# keeps the lookahead full, the step to capture next is steps[read_ptr]
+cdef int pybladerf_hop_fill(pybladerf_hop_plan *plan) noexcept nogil:
+    cdef int result
+
+    while plan.in_flight < plan.lookahead:
+        result = pybladerf_hop_schedule(plan)
+        if result < 0:
+            return result
+    return 0
+
+
+# called after steps[read_ptr] was captured, returns 1 when it was the last step of a cycle
+cdef int pybladerf_hop_complete(pybladerf_hop_plan *plan) noexcept nogil:
+    cdef pybladerf_hop_step *step = &plan.steps[plan.read_ptr]
+    cdef int cycle_done = step.position == plan.order_len - 1
+
+    if step.recovering:
+        plan.recovered_steps.fetch_add(1)
+
+    plan.read_ptr = (plan.read_ptr + 1) % PYBLADERF_HOP_MAX_LOOKAHEAD
+    plan.in_flight -= 1
+    plan.stable_hops += 1
+
+    # a whole cycle without misses, the lookahead and lead time go back down
+    if plan.stable_hops >= max(<uint64_t> plan.order_len, 64):
+        plan.stable_hops = 0
+        plan.recovery_lead = plan.min_recovery_lead
+        if plan.lookahead > plan.min_lookahead:
+            plan.lookahead -= 1
+
+    if cycle_done:
+        plan.cycles.fetch_add(1)
+    return cycle_done
+
+
+# called when steps[read_ptr] failed with TIME_PAST, only the steps whose capture time went by are lost
+cdef int pybladerf_hop_resync(pybladerf_hop_plan *plan) noexcept nogil:
+    cdef uint64_t now = 0
+    cdef uint8_t missed = 0
+    cdef uint8_t i
+    cdef int result
+
+    plan.time_past_resets.fetch_add(1)
+
+    result = cbladerf.bladerf_get_timestamp(plan.device, cbladerf.BLADERF_RX, &now)
+    if result < 0:
+        return result
+
+    for i in range(plan.in_flight):
+        if plan.steps[(plan.read_ptr + i) % PYBLADERF_HOP_MAX_LOOKAHEAD].schedule_time <= now:
+            missed += 1
+    missed = max(missed, 1)
+    plan.missed_steps.fetch_add(missed)
+
+    result = cbladerf.bladerf_cancel_scheduled_retunes(plan.device, plan.channel)
+    if result < 0:
+        return result
+
+    # a miss before the previous recovery got through the lookahead needs more lead time
+    if plan.stable_hops < plan.lookahead:
+        plan.recovery_lead = min(plan.recovery_lead * 2, plan.start_lead)
+    plan.lookahead = min(plan.lookahead * 2, <uint8_t> PYBLADERF_HOP_MAX_LOOKAHEAD)
+    plan.stable_hops = 0
+    plan.recovering = missed
+
+    return pybladerf_hop_restart(plan, plan.steps[plan.read_ptr].position, plan.recovery_lead)
+
+
+cdef class pybladerf_hop_scheduler:
+
+    def __cinit__(self):
+        self.__plan = <pybladerf_hop_plan*> calloc(1, sizeof(pybladerf_hop_plan))
+        if self.__plan == NULL:
+            raise MemoryError()
+
+    def __init__(self, device: PyBladerfDevice, channel: int, hops: list[tuple[int, pybladerf_quick_tune]], dwell: int | list[int], settle: int | list[int],
+                 weights: list[int] | None = None, lookahead: int = 4, start_lead: int | None = None, recovery_lead: int | None = None) -> None:
+        cdef PyBladerfDevice c_device = device
+        cdef pybladerf_quick_tune quick_tune
+        cdef unsigned int sample_rate = 0
+        cdef size_t i
+
+        num_hops = len(hops)
+        if not 0 < num_hops <= 65535:
+            raise ValueError('pybladerf_hop_scheduler() failed: a plan needs 1 to 65535 hops')
+
+        dwells = [int(dwell)] * num_hops if isinstance(dwell, Integral) else [int(value) for value in dwell]
+        settle_times = [int(settle)] * num_hops if isinstance(settle, Integral) else [int(value) for value in settle]
+        weights = [1] * num_hops if weights is None else [int(weight) for weight in weights]
+        if len(dwells) != num_hops or len(settle_times) != num_hops or len(weights) != num_hops:
+            raise ValueError('pybladerf_hop_scheduler() failed: dwell, settle and weights need one value per hop')
+        if min(dwells) <= 0 or min(settle_times) < 0 or min(weights) <= 0:
+            raise ValueError('pybladerf_hop_scheduler() failed: dwell and weights must be positive, settle must not be negative')
+
+        # smooth weighted round robin, a hop with weight w comes back w times per cycle at evenly spread positions
+        total = sum(weights)
+        current = [0] * num_hops
+        order = []
+        for _ in range(total):
+            for i in range(num_hops):
+                current[i] += weights[i]
+            best = max(range(num_hops), key=current.__getitem__)
+            current[best] -= total
+            order.append(best)
+
+        if start_lead is None or recovery_lead is None:
+            result = cbladerf.bladerf_get_sample_rate(c_device.get_ptr(), channel, &sample_rate)
+            raise_error('pybladerf_get_sample_rate()', result)
+
+        # __init__ may run again on the same object, the previous plan is dropped
+        free(self.__plan.quick_tunes)
+        free(self.__plan.frequencies)
+        free(self.__plan.settle_times)
+        free(self.__plan.dwells)
+        free(self.__plan.order)
+        memset(self.__plan, 0, sizeof(pybladerf_hop_plan))
+
+        self.started = False
+        self.device = device
+        self.__plan.device = c_device.get_ptr()
+        self.__plan.channel = channel
+        self.__plan.num_hops = num_hops
+        self.__plan.order_len = total
+        self.__plan.rffe_profiles = min(8, total)
+        self.__plan.min_lookahead = max(1, min(<int> PYBLADERF_HOP_MAX_LOOKAHEAD, lookahead))
+        self.__plan.lookahead = self.__plan.min_lookahead
+        self.__plan.start_lead = sample_rate // 1000 * 150 if start_lead is None else start_lead
+        self.__plan.min_recovery_lead = max(1, sample_rate // 1000 * 5 if recovery_lead is None else recovery_lead)
+        self.__plan.recovery_lead = self.__plan.min_recovery_lead
+
+        self.__plan.quick_tunes = <cbladerf.bladerf_quick_tune*> malloc(num_hops * sizeof(cbladerf.bladerf_quick_tune))
+        self.__plan.frequencies = <uint64_t*> malloc(num_hops * sizeof(uint64_t))
+        self.__plan.settle_times = <uint64_t*> malloc(num_hops * sizeof(uint64_t))
+        self.__plan.dwells = <uint32_t*> malloc(num_hops * sizeof(uint32_t))
+        self.__plan.order = <uint16_t*> malloc(total * sizeof(uint16_t))
+        if self.__plan.quick_tunes == NULL or self.__plan.frequencies == NULL or self.__plan.settle_times == NULL or self.__plan.dwells == NULL or self.__plan.order == NULL:
+            raise MemoryError()
+
+        for i in range(num_hops):
+            quick_tune = hops[i][1]
+            self.__plan.quick_tunes[i] = quick_tune.get_ptr()[0]
+            self.__plan.frequencies[i] = hops[i][0]
+            self.__plan.settle_times[i] = settle_times[i]
+            self.__plan.dwells[i] = dwells[i]
+        for i in range(total):
+            self.__plan.order[i] = order[i]
+
+    def __dealloc__(self):
+        if self.__plan != NULL:
+            free(self.__plan.quick_tunes)
+            free(self.__plan.frequencies)
+            free(self.__plan.settle_times)
+            free(self.__plan.dwells)
+            free(self.__plan.order)
+            free(self.__plan)
+            self.__plan = NULL
+
+    cdef pybladerf_hop_plan *get_ptr(self):
+        return self.__plan
+
+    def start(self) -> None:
+        cdef int result
+        if self.__plan.order == NULL:
+            raise RuntimeError('pybladerf_hop_start() failed: the scheduler has no plan!')
+
+        self.started = False
+        with nogil:
+            result = pybladerf_hop_start(self.__plan)
+        raise_error('pybladerf_hop_start()', result)
+        self.started = True
+
+    def next(self) -> tuple[int, int, int, int]:
+        cdef pybladerf_hop_step *step
+        cdef int result
+        if not self.started:
+            raise RuntimeError('pybladerf_hop_scheduler.next() failed: call start() first!')
+
+        with nogil:
+            result = pybladerf_hop_fill(self.__plan)
+        raise_error('pybladerf_schedule_retune()', result)
+        step = &self.__plan.steps[self.__plan.read_ptr]
+        return step.frequency, step.schedule_time, step.dwell, step.hop
+
+    def complete(self) -> bool:
+        if not self.started or self.__plan.in_flight == 0:
+            raise RuntimeError('pybladerf_hop_scheduler.complete() failed: no step is in flight, call next() first!')
+        return pybladerf_hop_complete(self.__plan) == 1
+
+    def resync(self) -> None:
+        cdef int result
+        if not self.started or self.__plan.in_flight == 0:
+            raise RuntimeError('pybladerf_hop_resync() failed: no step is in flight, call next() first!')
+
+        with nogil:
+            result = pybladerf_hop_resync(self.__plan)
+        raise_error('pybladerf_hop_resync()', result)
+
+    property num_hops:
+        def __get__(self) -> int:
+            return self.__plan.num_hops
+
+    property order:
+        def __get__(self) -> list[int]:
+            return [self.__plan.order[i] for i in range(self.__plan.order_len)]
+
+    property lookahead:
+        def __get__(self) -> int:
+            return self.__plan.lookahead
+
+    property cycles:
+        def __get__(self) -> int:
+            return self.__plan.cycles.load()
+
+    property time_past_resets:
+        def __get__(self) -> int:
+            return self.__plan.time_past_resets.load()
+
+    property missed_steps:
+        def __get__(self) -> int:
+            return self.__plan.missed_steps.load()
+
+    property recovered_steps:
+        def __get__(self) -> int:
+            return self.__plan.recovered_steps.load()
 
 
 cdef class PyBladerfDevice:
 
     def __cinit__(self):
         self.__bladerf_device = NULL
+        self.rx_callback = None
+        self.tx_callback = None
+        self.tx_complete_callback = None
+        self.tx_complete_enabled = False
+        self.sync_rx_itemsize = 0
+        self.rx_streams = 0
+        self.tx_streams = 0
 
     def __dealloc__(self):
-        global global_callbacks
-
         if self.__bladerf_device != NULL:
-            if <size_t> self.__bladerf_device in global_callbacks.keys():
-                global_callbacks.pop(<size_t> self.__bladerf_device)
-
             cbladerf.bladerf_close(self.__bladerf_device)
             self.__bladerf_device = NULL
 
@@ -1337,30 +2307,30 @@ cdef class PyBladerfDevice:
         return &self.__bladerf_device
 
     cdef void _setup_device(self):
-        global global_callbacks
-
         if self.__bladerf_device is not NULL:
             self.serialno = self.pybladerf_get_serial()
-
-            global_callbacks[<size_t> self.__bladerf_device] = {
-                '__rx_callback': None,
-                '__tx_callback': None,
-                '__tx_complete_callback': None,
-                'tx_complete_enabled': False,
-                'device': self,
-            }
             return
 
         raise RuntimeError(f'_setup_device() failed: Device not initialized!')
 
+    cdef void _bind_callbacks(self, pybladerf_async_data *async_data, c_bool tx):
+        callback = self.tx_callback if tx else self.rx_callback
+        valid_num_samples = c_int(0)
+
+        async_data.device = <PyObject*> self
+        async_data.callback = <PyObject*> callback if callback is not None else NULL
+        async_data.complete_callback = <PyObject*> self.tx_complete_callback if tx and self.tx_complete_callback is not None else NULL
+        async_data.valid_num_samples = <PyObject*> valid_num_samples
+        async_data.tx_complete = tx and self.tx_complete_enabled
+
+        Py_XINCREF(async_data.device)
+        Py_XINCREF(async_data.callback)
+        Py_XINCREF(async_data.complete_callback)
+        Py_XINCREF(async_data.valid_num_samples)
+
     # ---- device ---- #
     def pybladerf_close(self) -> None:
-        global global_callbacks
-
         if self.__bladerf_device is not NULL:
-            if <size_t> self.__bladerf_device in global_callbacks.keys():
-                global_callbacks.pop(<size_t> self.__bladerf_device)
-
             cbladerf.bladerf_close(self.__bladerf_device)
             self.__bladerf_device = NULL
 
@@ -1669,6 +2639,9 @@ cdef class PyBladerfDevice:
         result = cbladerf.bladerf_sync_config(self.__bladerf_device, layout, data_format, <unsigned int> num_buffers, <unsigned int> buffer_size, <unsigned int> num_transfers, <unsigned int> stream_timeout)
         raise_error('pybladerf_sync_config()', result)
 
+        if layout in {pybladerf_channel_layout.PYBLADERF_RX_X1, pybladerf_channel_layout.PYBLADERF_RX_X2}:
+            self.sync_rx_itemsize = 2 if data_format in {pybladerf_format.PYBLADERF_FORMAT_SC16_Q11, pybladerf_format.PYBLADERF_FORMAT_SC16_Q11_META} else 1
+
     def pybladerf_sync_tx(self, samples: np.ndarray[Any, Any], num_samples: int, metadata: pybladerf_metadata | None = None, timeout_ms: int = 0) -> None:
         cdef cbladerf.bladerf_metadata *c_metadata_ptr = NULL
         cdef pybladerf_metadata metadata_link
@@ -1703,60 +2676,176 @@ cdef class PyBladerfDevice:
             result = cbladerf.bladerf_sync_rx(self.__bladerf_device, c_samples_ptr, c_num_samples, c_metadata_ptr, c_timeout_ms)
         raise_error('pybladerf_sync_rx()', result)
 
-    def pybladerf_init_rx_stream(self, num_buffers: int, data_format: pybladerf_format, samples_per_buffer: int, num_transfers: int) -> pybladerf_stream:
+    def pybladerf_sync_rx_many(self, samples: np.ndarray[Any, Any], num_samples: int, timestamps: np.ndarray[Any, Any] | None = None, timeout_ms: int = 0) -> tuple[np.ndarray[Any, Any], np.ndarray[Any, Any], np.ndarray[Any, Any]]:
+        if samples.ndim != 2 or samples.strides[1] != samples.itemsize or samples.shape[1] < num_samples * 2:
+            raise RuntimeError('pybladerf_sync_rx_many() failed: samples must be a row-contiguous [n_bursts, num_samples * 2] array!')
+        if samples.strides[0] < num_samples * 2 * samples.itemsize:
+            raise RuntimeError('pybladerf_sync_rx_many() failed: samples rows must not overlap!')
+        if not samples.flags.writeable:
+            raise RuntimeError('pybladerf_sync_rx_many() failed: samples must be writeable!')
+        if self.sync_rx_itemsize != 0 and samples.itemsize != self.sync_rx_itemsize:
+            raise RuntimeError(f'pybladerf_sync_rx_many() failed: samples itemsize must be {self.sync_rx_itemsize} for the configured rx format!')
+
+        cdef size_t n_bursts = <size_t> samples.shape[0]
+        if timestamps is not None:
+            timestamps = np.ascontiguousarray(timestamps, dtype=np.uint64)
+            if <size_t> timestamps.shape[0] != n_bursts:
+                raise RuntimeError('pybladerf_sync_rx_many() failed: timestamps must hold one timestamp per burst!')
+
+        results = np.zeros(n_bursts, dtype=np.int32)
+        actual_timestamps = np.zeros(n_bursts, dtype=np.uint64)
+        status = np.zeros(n_bursts, dtype=np.uint32)
+
+        cdef uint8_t *c_samples_ptr = <uint8_t*> <uintptr_t> samples.ctypes.data
+        cdef size_t c_row_stride = <size_t> samples.strides[0]
+        cdef uint64_t *c_timestamps_ptr = <uint64_t*> <uintptr_t> timestamps.ctypes.data if timestamps is not None else NULL
+        cdef int32_t *c_results_ptr = <int32_t*> <uintptr_t> results.ctypes.data
+        cdef uint64_t *c_actual_ptr = <uint64_t*> <uintptr_t> actual_timestamps.ctypes.data
+        cdef uint32_t *c_status_ptr = <uint32_t*> <uintptr_t> status.ctypes.data
+        cdef unsigned int c_num_samples = <unsigned int> num_samples
+        cdef unsigned int c_timeout_ms = <unsigned int> timeout_ms
+        cdef cbladerf.bladerf_metadata c_metadata
+        cdef size_t i
+
+        with nogil:
+            for i in range(n_bursts):
+                memset(&c_metadata, 0, sizeof(c_metadata))
+                if c_timestamps_ptr != NULL:
+                    c_metadata.timestamp = c_timestamps_ptr[i]
+                else:
+                    c_metadata.flags = PYMETADATA_FLAG_RX_NOW
+
+                c_results_ptr[i] = cbladerf.bladerf_sync_rx(self.__bladerf_device, c_samples_ptr + i * c_row_stride, c_num_samples, &c_metadata, c_timeout_ms)
+                c_actual_ptr[i] = c_metadata.timestamp
+                c_status_ptr[i] = c_metadata.status
+
+        return results, actual_timestamps, status
+
+    def pybladerf_init_rx_stream(self, num_buffers: int, data_format: pybladerf_format, samples_per_buffer: int, num_transfers: int, zero_copy: bool = False, native: bool = False) -> pybladerf_stream:
+        if zero_copy and native:
+            raise RuntimeError('pybladerf_init_rx_stream() failed: zero_copy and native modes are mutually exclusive!')
+        if native and num_transfers >= num_buffers:
+            raise ValueError('pybladerf_init_rx_stream() failed: native mode needs num_transfers to be less than num_buffers!')
+        if zero_copy and data_format in {pybladerf_format.PYBLADERF_FORMAT_SC16_Q11_META, pybladerf_format.PYBLADERF_FORMAT_SC8_Q7_META}:
+            raise RuntimeError('pybladerf_init_rx_stream() failed: zero_copy mode does not support meta formats!')
+
         cdef pybladerf_stream pystream = pybladerf_stream()
-        cdef pybladerf_async_data* async_data = <pybladerf_async_data*> malloc(sizeof(pybladerf_async_data))
+        cdef pybladerf_async_data* async_data = <pybladerf_async_data*> calloc(1, sizeof(pybladerf_async_data))
         cdef void **buffers
         cdef int result = -1
 
-        async_data.bytes_per_sample = 4 if data_format == pybladerf_format.PYBLADERF_FORMAT_SC16_Q11 else 2
+        async_data.bytes_per_sample = 4 if data_format in {pybladerf_format.PYBLADERF_FORMAT_SC16_Q11, pybladerf_format.PYBLADERF_FORMAT_SC16_Q11_META} else 2
         async_data.package_size = USB_PACKAGE_SIZE_SS if self.pybladerf_device_speed() == pybladerf_dev_speed.PYBLADERF_DEVICE_SPEED_SUPER else USB_PACKAGE_SIZE_HS
-        async_data.packages_per_buffer = samples_per_buffer // (async_data.package_size // async_data.bytes_per_sample)
-        async_data.samples_per_package = (samples_per_buffer - PYMETADATA_HEADER_SIZE) // async_data.bytes_per_sample
+        async_data.packages_per_buffer = samples_per_buffer * async_data.bytes_per_sample // async_data.package_size
+        async_data.samples_per_package = (async_data.package_size - PYMETADATA_HEADER_SIZE) // async_data.bytes_per_sample
+        async_data.meta = data_format in {pybladerf_format.PYBLADERF_FORMAT_SC16_Q11_META, pybladerf_format.PYBLADERF_FORMAT_SC8_Q7_META}
         async_data.pystream = <void*>pystream
-        async_data.tx_complete = False
+        async_data.zero_copy = zero_copy
+        async_data.native = native
+        async_data.tx_stream = False
 
-        # if data_format in {pybladerf_format.PYBLADERF_FORMAT_SC16_Q11_META, pybladerf_format.PYBLADERF_FORMAT_SC8_Q7_META}:
-
-        if data_format == pybladerf_format.PYBLADERF_FORMAT_SC16_Q11:
+        if async_data.meta and (samples_per_buffer * async_data.bytes_per_sample) % async_data.package_size != 0:
+            package_samples = async_data.package_size // async_data.bytes_per_sample
+            free(async_data)
+            raise RuntimeError(f'pybladerf_init_rx_stream() failed: samples_per_buffer must be a multiple of {package_samples} for meta formats!')
+
+        if native:
+            result = cbladerf.bladerf_init_stream(pystream.get_double_ptr(), self.__bladerf_device, __rx_callback_native, &buffers, <size_t> num_buffers, data_format, <size_t> samples_per_buffer, <size_t> num_transfers, <void*> async_data)
+        elif zero_copy and data_format in {pybladerf_format.PYBLADERF_FORMAT_SC16_Q11, pybladerf_format.PYBLADERF_FORMAT_SC8_Q7}:
+            result = cbladerf.bladerf_init_stream(pystream.get_double_ptr(), self.__bladerf_device, __rx_callback_zero_copy, &buffers, <size_t> num_buffers, data_format, <size_t> samples_per_buffer, <size_t> num_transfers, <void*> async_data)
+        elif async_data.meta and not zero_copy:
+            result = cbladerf.bladerf_init_stream(pystream.get_double_ptr(), self.__bladerf_device, __rx_callback_meta, &buffers, <size_t> num_buffers, data_format, <size_t> samples_per_buffer, <size_t> num_transfers, <void*> async_data)
+        elif data_format == pybladerf_format.PYBLADERF_FORMAT_SC16_Q11:
             result = cbladerf.bladerf_init_stream(pystream.get_double_ptr(), self.__bladerf_device, __rx_callback_SC16_Q11, &buffers, <size_t> num_buffers, data_format, <size_t> samples_per_buffer, <size_t> num_transfers, <void*> async_data)
         elif data_format == pybladerf_format.PYBLADERF_FORMAT_SC8_Q7:
             result = cbladerf.bladerf_init_stream(pystream.get_double_ptr(), self.__bladerf_device, __rx_callback_SC8_Q7, &buffers, <size_t> num_buffers, data_format, <size_t> samples_per_buffer, <size_t> num_transfers, <void*> async_data)
         else:
+            free(async_data)
             raise raise_error('pybladerf_init_rx_stream', -8)
         if result < 0:
             free(async_data)
 
         raise_error('pybladerf_init_rx_stream', result)
+        self._bind_callbacks(async_data, False)
+        try:
+            if zero_copy:
+                pystream._init_buffer_views(np.int16 if data_format == pybladerf_format.PYBLADERF_FORMAT_SC16_Q11 else np.int8, <size_t> num_transfers, False)
+            elif native:
+                pystream._init_native_rings(<size_t> num_transfers)
+            elif async_data.meta:
+                pystream._init_meta_views()
+        except MemoryError:
+            pystream._deinit()
+            raise
+
+        self.rx_streams += 1
         Py_INCREF(pystream)
         return pystream
 
-    def pybladerf_init_tx_stream(self, num_buffers: int, data_format: pybladerf_format, samples_per_buffer: int, num_transfers: int) -> pybladerf_stream:
+    def pybladerf_init_tx_stream(self, num_buffers: int, data_format: pybladerf_format, samples_per_buffer: int, num_transfers: int, zero_copy: bool = False, native: bool = False) -> pybladerf_stream:
+        if zero_copy and native:
+            raise RuntimeError('pybladerf_init_tx_stream() failed: zero_copy and native modes are mutually exclusive!')
+        if native and num_transfers >= num_buffers:
+            raise ValueError('pybladerf_init_tx_stream() failed: native mode needs num_transfers to be less than num_buffers!')
+        if zero_copy and data_format in {pybladerf_format.PYBLADERF_FORMAT_SC16_Q11_META, pybladerf_format.PYBLADERF_FORMAT_SC8_Q7_META}:
+            raise RuntimeError('pybladerf_init_tx_stream() failed: zero_copy mode does not support meta formats!')
+        if native and num_buffers < 2:
+            raise RuntimeError('pybladerf_init_tx_stream() failed: native mode needs at least 2 buffers!')
+        if native and data_format in {pybladerf_format.PYBLADERF_FORMAT_SC16_Q11_META, pybladerf_format.PYBLADERF_FORMAT_SC8_Q7_META}:
+            raise RuntimeError('pybladerf_init_tx_stream() failed: native mode does not support meta formats!')
+
         cdef pybladerf_stream pystream = pybladerf_stream()
-        cdef pybladerf_async_data* async_data = <pybladerf_async_data*> malloc(sizeof(pybladerf_async_data))
+        cdef pybladerf_async_data* async_data = <pybladerf_async_data*> calloc(1, sizeof(pybladerf_async_data))
         cdef void **buffers
         cdef int result = -1
 
-        async_data.bytes_per_sample = 4 if data_format == pybladerf_format.PYBLADERF_FORMAT_SC16_Q11 else 2
+        async_data.bytes_per_sample = 4 if data_format in {pybladerf_format.PYBLADERF_FORMAT_SC16_Q11, pybladerf_format.PYBLADERF_FORMAT_SC16_Q11_META} else 2
         async_data.package_size = USB_PACKAGE_SIZE_SS if self.pybladerf_device_speed() == pybladerf_dev_speed.PYBLADERF_DEVICE_SPEED_SUPER else USB_PACKAGE_SIZE_HS
-        async_data.packages_per_buffer = samples_per_buffer // (async_data.package_size // async_data.bytes_per_sample)
-        async_data.samples_per_package = (samples_per_buffer - PYMETADATA_HEADER_SIZE) // async_data.bytes_per_sample
+        async_data.packages_per_buffer = samples_per_buffer * async_data.bytes_per_sample // async_data.package_size
+        async_data.samples_per_package = (async_data.package_size - PYMETADATA_HEADER_SIZE) // async_data.bytes_per_sample
+        async_data.meta = data_format in {pybladerf_format.PYBLADERF_FORMAT_SC16_Q11_META, pybladerf_format.PYBLADERF_FORMAT_SC8_Q7_META}
         async_data.pystream = <void*>pystream
-        async_data.tx_complete = False
+        async_data.zero_copy = zero_copy
+        async_data.native = native
+        async_data.tx_stream = True
 
-        # if data_format in {pybladerf_format.PYBLADERF_FORMAT_SC16_Q11_META, pybladerf_format.PYBLADERF_FORMAT_SC8_Q7_META}:
-
-        if data_format == pybladerf_format.PYBLADERF_FORMAT_SC16_Q11:
+        if async_data.meta and (samples_per_buffer * async_data.bytes_per_sample) % async_data.package_size != 0:
+            package_samples = async_data.package_size // async_data.bytes_per_sample
+            free(async_data)
+            raise RuntimeError(f'pybladerf_init_tx_stream() failed: samples_per_buffer must be a multiple of {package_samples} for meta formats!')
+
+        if native and data_format in {pybladerf_format.PYBLADERF_FORMAT_SC16_Q11, pybladerf_format.PYBLADERF_FORMAT_SC8_Q7}:
+            result = cbladerf.bladerf_init_stream(pystream.get_double_ptr(), self.__bladerf_device, __tx_callback_native, &buffers, <size_t> num_buffers, data_format, <size_t> samples_per_buffer, <size_t> num_transfers, <void*> async_data)
+        elif zero_copy and data_format in {pybladerf_format.PYBLADERF_FORMAT_SC16_Q11, pybladerf_format.PYBLADERF_FORMAT_SC8_Q7}:
+            result = cbladerf.bladerf_init_stream(pystream.get_double_ptr(), self.__bladerf_device, __tx_callback_zero_copy, &buffers, <size_t> num_buffers, data_format, <size_t> samples_per_buffer, <size_t> num_transfers, <void*> async_data)
+        elif async_data.meta and not zero_copy:
+            result = cbladerf.bladerf_init_stream(pystream.get_double_ptr(), self.__bladerf_device, __tx_callback_meta, &buffers, <size_t> num_buffers, data_format, <size_t> samples_per_buffer, <size_t> num_transfers, <void*> async_data)
+        elif data_format == pybladerf_format.PYBLADERF_FORMAT_SC16_Q11:
             result = cbladerf.bladerf_init_stream(pystream.get_double_ptr(), self.__bladerf_device, __tx_callback_SC16_Q11, &buffers, <size_t> num_buffers, data_format, <size_t> samples_per_buffer, <size_t> num_transfers, <void*> async_data)
         elif data_format == pybladerf_format.PYBLADERF_FORMAT_SC8_Q7:
             result = cbladerf.bladerf_init_stream(pystream.get_double_ptr(), self.__bladerf_device, __tx_callback_SC8_Q7, &buffers, <size_t> num_buffers, data_format, <size_t> samples_per_buffer, <size_t> num_transfers, <void*> async_data)
         else:
+            free(async_data)
             raise raise_error('pybladerf_init_tx_stream', -8)
 
         if result < 0:
             free(async_data)
 
         raise_error('pybladerf_init_tx_stream', result)
+        self._bind_callbacks(async_data, True)
+        try:
+            if zero_copy:
+                # tx buffers are handed out by the callback, none of them is in flight yet
+                pystream._init_buffer_views(np.int16 if data_format == pybladerf_format.PYBLADERF_FORMAT_SC16_Q11 else np.int8, 0, True)
+            elif native:
+                pystream._init_native_rings(<size_t> num_transfers)
+            elif async_data.meta:
+                pystream._init_meta_views()
+        except MemoryError:
+            pystream._deinit()
+            raise
+
+        self.tx_streams += 1
         Py_INCREF(pystream)
         return pystream
 
@@ -1784,7 +2873,15 @@ cdef class PyBladerfDevice:
         raise_error('pybladerf_submit_stream_buffer_nb()', result)
 
     def pybladerf_deinit_stream(self, stream: pybladerf_stream) -> None:
-        cbladerf.bladerf_deinit_stream(stream.get_ptr())
+        cdef pybladerf_async_data *async_data = stream.get_async_data()
+        cdef c_bool tx_stream = async_data != NULL and async_data.tx_stream
+
+        stream._deinit()
+        if async_data != NULL:
+            if tx_stream:
+                self.tx_streams -= 1
+            else:
+                self.rx_streams -= 1
         Py_DECREF(stream)
 
     def pybladerf_set_stream_timeout(self, direction: pybladerf_direction, timeout: int) -> None:
@@ -2031,38 +3128,38 @@ cdef class PyBladerfDevice:
 
     # ---- new function ---- #
     def pybladerf_enable_tx_block_complete_callback(self) -> None:
-        global global_callbacks
-
+        if self.tx_streams:
+            raise RuntimeError('pybladerf_enable_tx_block_complete_callback() failed: Callbacks are bound when a tx stream is initialized, deinitialize it first!')
         if self.__bladerf_device is not NULL:
-            global_callbacks[<size_t> self.__bladerf_device]['tx_complete_enabled'] = True
+            self.tx_complete_enabled = True
             return
 
         raise RuntimeError(f'pybladerf_enable_tx_block_complete_callback() failed: Device not initialized!')
 
     # ---- python callbacks setters ---- #
-    def set_rx_callback(self, rx_callback_function: Callable[[Self, pybladerf_stream, np.ndarray[Any, Any], int], int]) -> None:
-        global global_callbacks
-
+    def set_rx_callback(self, rx_callback_function: Callable[[Self, pybladerf_stream, np.ndarray[Any, Any], int], int] | Callable[[Self, pybladerf_stream, np.ndarray[Any, Any], int, np.ndarray[Any, Any], np.ndarray[Any, Any]], int]) -> None:
+        if self.rx_streams:
+            raise RuntimeError('set_rx_callback() failed: Callbacks are bound when a rx stream is initialized, deinitialize it first!')
         if self.__bladerf_device is not NULL:
-            global_callbacks[<size_t> self.__bladerf_device]['__rx_callback'] = rx_callback_function
+            self.rx_callback = rx_callback_function
             return
 
         raise RuntimeError(f'set_rx_callback() failed: Device not initialized!')
 
-    def set_tx_callback(self, tx_callback_function: Callable[[Self, pybladerf_stream, np.ndarray[Any, Any], int, int], int]) -> None:
-        global global_callbacks
-
+    def set_tx_callback(self, tx_callback_function: Callable[[Self, pybladerf_stream, np.ndarray[Any, Any], int, int], int] | Callable[[Self, pybladerf_stream, np.ndarray[Any, Any], int, int, np.ndarray[Any, Any], np.ndarray[Any, Any]], int]) -> None:
+        if self.tx_streams:
+            raise RuntimeError('set_tx_callback() failed: Callbacks are bound when a tx stream is initialized, deinitialize it first!')
         if self.__bladerf_device is not NULL:
-            global_callbacks[<size_t> self.__bladerf_device]['__tx_callback'] = tx_callback_function
+            self.tx_callback = tx_callback_function
             return
 
         raise RuntimeError(f'set_tx_callback() failed: Device not initialized!')
 
     def set_tx_complete_callback(self, tx_complete_callback_function: Callable[[Self, pybladerf_stream, np.ndarray[Any, Any], int], None]) -> None:
-        global global_callbacks
-
+        if self.tx_streams:
+            raise RuntimeError('set_tx_complete_callback() failed: Callbacks are bound when a tx stream is initialized, deinitialize it first!')
         if self.__bladerf_device is not NULL:
-            global_callbacks[<size_t> self.__bladerf_device]['__tx_complete_callback'] = tx_complete_callback_function
+            self.tx_complete_callback = tx_complete_callback_function
             return
 
         raise RuntimeError(f'set_tx_complete_callback() failed: Device not initialized!')
@@ -2155,3 +3252,93 @@ def python_bladerf_library_version() -> pybladerf_version:
         ''
     )
     return version
+
+cdef cnp.ndarray iq_output(object out, size_t count, object dtype):
+    if out is None:
+        return np.empty(count, dtype=dtype)
+    if not isinstance(out, np.ndarray) or not out.flags.c_contiguous or out.dtype != dtype or out.size < count:
+        raise ValueError(f'out should be a contiguous {np.dtype(dtype).name} array of at least {count} values')
+    return out.reshape(-1)[:count]
+
+cdef cnp.ndarray iq_to_complex64(object samples, object out, c_bool sc8):
+    cdef cnp.ndarray c_samples = np.ascontiguousarray(samples, dtype=np.int8 if sc8 else np.int16).reshape(-1)
+    if c_samples.size % 2:
+        raise ValueError('samples should hold interleaved I/Q pairs')
+
+    cdef size_t count = c_samples.size
+    cdef cnp.ndarray c_out = iq_output(out, count // 2, np.complex64)
+    cdef void *src = cnp.PyArray_DATA(c_samples)
+    cdef float *dst = <float*> cnp.PyArray_DATA(c_out)
+
+    with nogil:
+        if sc8:
+            pybladerf_iq_to_float[int8_t](<int8_t*> src, dst, count, 1.0 / 128.0)
+        else:
+            pybladerf_iq_to_float[int16_t](<int16_t*> src, dst, count, 1.0 / 2048.0)
+    return c_out
+
+cdef cnp.ndarray complex64_to_iq(object samples, object out, c_bool sc8):
+    cdef cnp.ndarray c_samples = np.ascontiguousarray(samples, dtype=np.complex64).reshape(-1)
+    cdef size_t count = c_samples.size * 2
+    cdef cnp.ndarray c_out = iq_output(out, count, np.int8 if sc8 else np.int16)
+    cdef float *src = <float*> cnp.PyArray_DATA(c_samples)
+    cdef void *dst = cnp.PyArray_DATA(c_out)
+
+    with nogil:
+        if sc8:
+            pybladerf_iq_from_float[int8_t](src, <int8_t*> dst, count, 128.0, -128.0, 127.0)
+        else:
+            pybladerf_iq_from_float[int16_t](src, <int16_t*> dst, count, 2048.0, -2048.0, 2047.0)
+    return c_out
+
+def pybladerf_sc16_q11_to_complex64(samples: np.ndarray[Any, Any], out: np.ndarray[Any, Any] | None = None) -> np.ndarray[Any, Any]:
+    return iq_to_complex64(samples, out, False)
+
+def pybladerf_sc8_q7_to_complex64(samples: np.ndarray[Any, Any], out: np.ndarray[Any, Any] | None = None) -> np.ndarray[Any, Any]:
+    return iq_to_complex64(samples, out, True)
+
+def pybladerf_complex64_to_sc16_q11(samples: np.ndarray[Any, Any], out: np.ndarray[Any, Any] | None = None) -> np.ndarray[Any, Any]:
+    return complex64_to_iq(samples, out, False)
+
+def pybladerf_complex64_to_sc8_q7(samples: np.ndarray[Any, Any], out: np.ndarray[Any, Any] | None = None) -> np.ndarray[Any, Any]:
+    return complex64_to_iq(samples, out, True)
+
+def pybladerf_iq_compress(samples: np.ndarray[Any, Any], codec: pybladerf_iq_codec = pybladerf_iq_codec.PYBLADERF_IQ_CODEC_BFP, bits: int = 8) -> np.ndarray[Any, Any]:
+    if codec == pybladerf_iq_codec.PYBLADERF_IQ_CODEC_BFP and not 2 <= bits <= 16:
+        raise ValueError('bits should be between 2 and 16')
+
+    cdef cnp.ndarray c_samples = np.ascontiguousarray(samples, dtype=np.int16).reshape(-1)
+    cdef size_t count = c_samples.size
+    cdef int c_codec = codec
+    cdef int c_bits = bits
+    cdef cnp.ndarray out = np.empty(pybladerf_codec_bound(count, c_codec, c_bits), dtype=np.uint8)
+    cdef const int16_t *src = <const int16_t*> cnp.PyArray_DATA(c_samples)
+    cdef uint8_t *dst = <uint8_t*> cnp.PyArray_DATA(out)
+    cdef size_t size
+
+    with nogil:
+        size = pybladerf_iq_encode(src, count, c_codec, c_bits, dst)
+    return out[:size]
+
+def pybladerf_iq_decompress(data: Any, count: int, codec: pybladerf_iq_codec = pybladerf_iq_codec.PYBLADERF_IQ_CODEC_BFP, bits: int = 8, out: np.ndarray[Any, Any] | None = None) -> np.ndarray[Any, Any]:
+    if codec == pybladerf_iq_codec.PYBLADERF_IQ_CODEC_BFP and not 2 <= bits <= 16:
+        raise ValueError('bits should be between 2 and 16')
+
+    cdef cnp.ndarray c_data = np.frombuffer(data, dtype=np.uint8)
+    cdef cnp.ndarray c_out = iq_output(out, count, np.int16)
+    cdef const uint8_t *src = <const uint8_t*> cnp.PyArray_DATA(c_data)
+    cdef int16_t *dst = <int16_t*> cnp.PyArray_DATA(c_out)
+    cdef size_t size = c_data.size
+    cdef size_t c_count = count
+    cdef int c_codec = codec
+    cdef int c_bits = bits
+    cdef size_t used
+
+    with nogil:
+        used = pybladerf_iq_decode(src, size, c_count, c_codec, c_bits, dst)
+    if used == PYBLADERF_CODEC_ERROR:
+        raise ValueError('pybladerf_iq_decompress() failed: data is truncated or corrupt')
+    return c_out
+
+def pybladerf_simd_backend() -> str:
+    return pybladerf_simd_name().decode('utf-8')
@@ -0,0 +1,259 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Block codecs for interleaved SC16_Q11 (or widened SC8_Q7) I/Q values. Every call
+ * encodes one self-contained block, so blocks can be coded on any thread and
+ * decoded in any order. Values are coded in groups of PYBLADERF_CODEC_GROUP.
+ *
+ * BFP: each group stores a 4-bit shared exponent followed by `bits`-bit signed
+ * mantissas, value = mantissa << exponent.
+ * LOSSLESS: I and Q are predicted from the previous I and Q of the block, the
+ * zigzagged residuals are Rice coded with a 4-bit parameter per group.
+ */
+#define PYBLADERF_CODEC_BFP 0
+#define PYBLADERF_CODEC_LOSSLESS 1
+#define PYBLADERF_CODEC_GROUP 32
+#define PYBLADERF_RICE_ESCAPE 24
+#define PYBLADERF_RICE_RAW_BITS 17
+#define PYBLADERF_CODEC_ERROR ((size_t) -1)
+
+struct pybladerf_bit_writer {
+    uint8_t *out;
+    size_t pos;
+    uint64_t acc;
+    int bits;
+};
+
+// bit streams are little-endian and LSB first, n is at most 32
+static inline void pybladerf_bits_put(pybladerf_bit_writer *w, uint32_t value, int n) {
+    w->acc |= (uint64_t) value << w->bits;
+    w->bits += n;
+    if (w->bits >= 32) {
+        w->out[w->pos] = (uint8_t) w->acc;
+        w->out[w->pos + 1] = (uint8_t) (w->acc >> 8);
+        w->out[w->pos + 2] = (uint8_t) (w->acc >> 16);
+        w->out[w->pos + 3] = (uint8_t) (w->acc >> 24);
+        w->pos += 4;
+        w->acc >>= 32;
+        w->bits -= 32;
+    }
+}
+
+static inline size_t pybladerf_bits_flush(pybladerf_bit_writer *w) {
+    while (w->bits > 0) {
+        w->out[w->pos++] = (uint8_t) w->acc;
+        w->acc >>= 8;
+        w->bits -= 8;
+    }
+    w->acc = 0;
+    w->bits = 0;
+    return w->pos;
+}
+
+struct pybladerf_bit_reader {
+    const uint8_t *in;
+    size_t size;
+    size_t pos;
+    uint64_t acc;
+    int bits;
+};
+
+static inline void pybladerf_bits_fill(pybladerf_bit_reader *r) {
+    if (r->bits <= 32 && r->pos + 4 <= r->size) {
+        const uint8_t *p = r->in + r->pos;
+        uint32_t word = (uint32_t) p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+        r->acc |= (uint64_t) word << r->bits;
+        r->bits += 32;
+        r->pos += 4;
+        return;
+    }
+    while (r->bits <= 56 && r->pos < r->size) {
+        r->acc |= (uint64_t) r->in[r->pos++] << r->bits;
+        r->bits += 8;
+    }
+}
+
+static inline int pybladerf_bits_get(pybladerf_bit_reader *r, int n, uint32_t *value) {
+    if (r->bits < n) {
+        pybladerf_bits_fill(r);
+        if (r->bits < n)
+            return 0;
+    }
+    *value = (uint32_t) (r->acc & ((n < 32 ? (1ull << n) : 0x100000000ull) - 1));
+    r->acc >>= n;
+    r->bits -= n;
+    return 1;
+}
+
+static inline size_t pybladerf_bits_consumed(const pybladerf_bit_reader *r) {
+    return r->pos - (size_t) (r->bits / 8);
+}
+
+static inline int pybladerf_bit_length(uint32_t v) {
+    int n = 0;
+    while (v) {
+        n++;
+        v >>= 1;
+    }
+    return n;
+}
+
+static inline int pybladerf_trailing_ones(uint64_t v) {
+#if defined(__GNUC__) || defined(__clang__)
+    return ~v ? __builtin_ctzll(~v) : 64;
+#else
+    int n = 0;
+    while (n < 64 && (v & 1)) {
+        n++;
+        v >>= 1;
+    }
+    return n;
+#endif
+}
+
+static inline size_t pybladerf_codec_bound(size_t count, int codec, int bits) {
+    size_t groups = (count + PYBLADERF_CODEC_GROUP - 1) / PYBLADERF_CODEC_GROUP;
+    if (codec == PYBLADERF_CODEC_BFP)
+        return (groups * 4 + count * (size_t) bits + 7) / 8;
+    return (groups * 4 + count * (PYBLADERF_RICE_ESCAPE + PYBLADERF_RICE_RAW_BITS) + 7) / 8;
+}
+
+static inline size_t pybladerf_bfp_encode(const int16_t *in, size_t count, int bits, uint8_t *out) {
+    pybladerf_bit_writer w = {out, 0, 0, 0};
+    const int32_t hi = (1 << (bits - 1)) - 1;
+    const int32_t lo = -(1 << (bits - 1));
+    const uint32_t mask = (uint32_t) ((1ull << bits) - 1);
+
+    for (size_t start = 0; start < count; start += PYBLADERF_CODEC_GROUP) {
+        size_t end = start + PYBLADERF_CODEC_GROUP < count ? start + PYBLADERF_CODEC_GROUP : count;
+        uint32_t peak = 0;
+        for (size_t i = start; i < end; i++) {
+            uint32_t a = (uint32_t) (in[i] < 0 ? -(int32_t) in[i] : in[i]);
+            peak = a > peak ? a : peak;
+        }
+
+        int exponent = pybladerf_bit_length(peak) - (bits - 1);
+        exponent = exponent < 0 ? 0 : exponent;
+        pybladerf_bits_put(&w, (uint32_t) exponent, 4);
+
+        int32_t round = exponent ? 1 << (exponent - 1) : 0;
+        for (size_t i = start; i < end; i++) {
+            int32_t m = ((int32_t) in[i] + round) >> exponent;
+            m = m > hi ? hi : (m < lo ? lo : m);
+            pybladerf_bits_put(&w, (uint32_t) m & mask, bits);
+        }
+    }
+    return pybladerf_bits_flush(&w);
+}
+
+static inline size_t pybladerf_bfp_decode(const uint8_t *in, size_t size, size_t count, int bits, int16_t *out) {
+    pybladerf_bit_reader r = {in, size, 0, 0, 0};
+    const uint32_t sign = 1u << (bits - 1);
+    uint32_t exponent = 0;
+    uint32_t m = 0;
+
+    for (size_t start = 0; start < count; start += PYBLADERF_CODEC_GROUP) {
+        size_t end = start + PYBLADERF_CODEC_GROUP < count ? start + PYBLADERF_CODEC_GROUP : count;
+        if (!pybladerf_bits_get(&r, 4, &exponent))
+            return PYBLADERF_CODEC_ERROR;
+        for (size_t i = start; i < end; i++) {
+            if (!pybladerf_bits_get(&r, bits, &m))
+                return PYBLADERF_CODEC_ERROR;
+            int32_t v = (int32_t) (m ^ sign) - (int32_t) sign;
+            v = (int32_t) ((uint32_t) v << exponent);
+            out[i] = (int16_t) (v > 32767 ? 32767 : (v < -32768 ? -32768 : v));
+        }
+    }
+    return pybladerf_bits_consumed(&r);
+}
+
+static inline size_t pybladerf_lossless_encode(const int16_t *in, size_t count, uint8_t *out) {
+    pybladerf_bit_writer w = {out, 0, 0, 0};
+    uint32_t residuals[PYBLADERF_CODEC_GROUP];
+    int32_t prev[2] = {0, 0};
+
+    for (size_t start = 0; start < count; start += PYBLADERF_CODEC_GROUP) {
+        size_t end = start + PYBLADERF_CODEC_GROUP < count ? start + PYBLADERF_CODEC_GROUP : count;
+        size_t n = end - start;
+        uint64_t sum = 0;
+        for (size_t i = start; i < end; i++) {
+            int32_t d = (int32_t) in[i] - prev[i & 1];
+            prev[i & 1] = in[i];
+            uint32_t u = ((uint32_t) d << 1) ^ (uint32_t) (d >> 31);
+            residuals[i - start] = u;
+            sum += u;
+        }
+
+        int k = 0;
+        while (k < 15 && ((uint64_t) n << (k + 1)) <= sum)
+            k++;
+        pybladerf_bits_put(&w, (uint32_t) k, 4);
+
+        for (size_t i = 0; i < n; i++) {
+            uint32_t q = residuals[i] >> k;
+            if (q < PYBLADERF_RICE_ESCAPE) {
+                pybladerf_bits_put(&w, (1u << q) - 1, (int) q + 1);
+                pybladerf_bits_put(&w, residuals[i] & ((1u << k) - 1), k);
+            } else {
+                pybladerf_bits_put(&w, (1u << PYBLADERF_RICE_ESCAPE) - 1, PYBLADERF_RICE_ESCAPE);
+                pybladerf_bits_put(&w, residuals[i], PYBLADERF_RICE_RAW_BITS);
+            }
+        }
+    }
+    return pybladerf_bits_flush(&w);
+}
+
+static inline size_t pybladerf_lossless_decode(const uint8_t *in, size_t size, size_t count, int16_t *out) {
+    pybladerf_bit_reader r = {in, size, 0, 0, 0};
+    int32_t prev[2] = {0, 0};
+    uint32_t k = 0;
+    uint32_t u = 0;
+
+    for (size_t start = 0; start < count; start += PYBLADERF_CODEC_GROUP) {
+        size_t end = start + PYBLADERF_CODEC_GROUP < count ? start + PYBLADERF_CODEC_GROUP : count;
+        if (!pybladerf_bits_get(&r, 4, &k))
+            return PYBLADERF_CODEC_ERROR;
+
+        for (size_t i = start; i < end; i++) {
+            if (r.bits <= PYBLADERF_RICE_ESCAPE)
+                pybladerf_bits_fill(&r);
+            int q = pybladerf_trailing_ones(r.acc);
+            q = q < r.bits ? q : r.bits;
+
+            if (q >= PYBLADERF_RICE_ESCAPE) {
+                r.acc >>= PYBLADERF_RICE_ESCAPE;
+                r.bits -= PYBLADERF_RICE_ESCAPE;
+                if (!pybladerf_bits_get(&r, PYBLADERF_RICE_RAW_BITS, &u))
+                    return PYBLADERF_CODEC_ERROR;
+            } else {
+                if (q == r.bits)
+                    return PYBLADERF_CODEC_ERROR;
+                r.acc >>= q + 1;
+                r.bits -= q + 1;
+                if (!pybladerf_bits_get(&r, (int) k, &u))
+                    return PYBLADERF_CODEC_ERROR;
+                u |= (uint32_t) q << k;
+            }
+
+            int32_t d = (int32_t) (u >> 1) ^ -(int32_t) (u & 1);
+            prev[i & 1] += d;
+            out[i] = (int16_t) prev[i & 1];
+        }
+    }
+    return pybladerf_bits_consumed(&r);
+}
+
+static inline size_t pybladerf_iq_encode(const int16_t *in, size_t count, int codec, int bits, uint8_t *out) {
+    if (codec == PYBLADERF_CODEC_BFP)
+        return pybladerf_bfp_encode(in, count, bits, out);
+    return pybladerf_lossless_encode(in, count, out);
+}
+
+static inline size_t pybladerf_iq_decode(const uint8_t *in, size_t size, size_t count, int codec, int bits, int16_t *out) {
+    if (codec == PYBLADERF_CODEC_BFP)
+        return pybladerf_bfp_decode(in, size, count, bits, out);
+    return pybladerf_lossless_decode(in, size, count, out);
+}
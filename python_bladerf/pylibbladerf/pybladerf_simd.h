@@ -0,0 +1,600 @@
+#pragma once
+
+#include <cfloat>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define PYBLADERF_SIMD_SSE2 1
+#define PYBLADERF_SIMD_VECTOR 1
+#if defined(__GNUC__) || defined(__clang__)
+#include <immintrin.h>
+#define PYBLADERF_SIMD_AVX2 1
+#endif
+#elif defined(__ARM_NEON) || defined(__aarch64__)
+#include <arm_neon.h>
+#define PYBLADERF_SIMD_NEON 1
+#define PYBLADERF_SIMD_VECTOR 1
+#endif
+
+/*
+ * Vector back ends. Every back end exposes the same set of static helpers so the
+ * kernels below are written once; the one matching the compiler target is selected
+ * at build time and the scalar code handles tails and plain builds. On x86 with
+ * GCC or Clang the kernels are also built for AVX2 (per-function target, no -mavx2
+ * needed) and picked at run time when the CPU supports it.
+ */
+
+#if defined(__GNUC__) || defined(__clang__)
+#define PYBLADERF_SIMD_INLINE __attribute__((always_inline)) inline
+#else
+#define PYBLADERF_SIMD_INLINE inline
+#endif
+
+#if defined(PYBLADERF_SIMD_AVX2)
+#define PYBLADERF_AVX2 __attribute__((target("avx2")))
+
+// the generic kernels hold AVX2 vectors when instantiated for it, they are only ever inlined into AVX2 functions
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpsabi"
+
+
+struct pybladerf_simd_avx2 {
+    typedef __m256 vf;
+    static const size_t width = 8;
+
+    PYBLADERF_AVX2 static inline vf set1(float v) { return _mm256_set1_ps(v); }
+    PYBLADERF_AVX2 static inline vf set_pair(float a, float b) { return _mm256_setr_ps(a, b, a, b, a, b, a, b); }
+    PYBLADERF_AVX2 static inline vf load(const float *p) { return _mm256_loadu_ps(p); }
+    PYBLADERF_AVX2 static inline void store(float *p, vf v) { _mm256_storeu_ps(p, v); }
+    PYBLADERF_AVX2 static inline vf add(vf a, vf b) { return _mm256_add_ps(a, b); }
+    PYBLADERF_AVX2 static inline vf sub(vf a, vf b) { return _mm256_sub_ps(a, b); }
+    PYBLADERF_AVX2 static inline vf mul(vf a, vf b) { return _mm256_mul_ps(a, b); }
+    PYBLADERF_AVX2 static inline vf max(vf a, vf b) { return _mm256_max_ps(a, b); }
+    PYBLADERF_AVX2 static inline vf min(vf a, vf b) { return _mm256_min_ps(a, b); }
+    PYBLADERF_AVX2 static inline vf select_lt(vf a, vf b, vf x, vf y) { return _mm256_blendv_ps(y, x, _mm256_cmp_ps(a, b, _CMP_LT_OQ)); }
+
+    PYBLADERF_AVX2 static inline vf exponent(vf x) {
+        __m256i e = _mm256_srli_epi32(_mm256_castps_si256(x), 23);
+        return _mm256_cvtepi32_ps(_mm256_sub_epi32(e, _mm256_set1_epi32(126)));
+    }
+
+    PYBLADERF_AVX2 static inline vf mantissa(vf x) {
+        __m256i m = _mm256_and_si256(_mm256_castps_si256(x), _mm256_set1_epi32(0x007FFFFF));
+        return _mm256_castsi256_ps(_mm256_or_si256(m, _mm256_set1_epi32(0x3F000000)));
+    }
+
+    PYBLADERF_AVX2 static inline vf load_int(const int16_t *p) { return _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *) p))); }
+    PYBLADERF_AVX2 static inline vf load_int(const int8_t *p) { return _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(_mm_loadl_epi64((const __m128i *) p))); }
+
+    PYBLADERF_AVX2 static inline __m128i pack_int(vf v) {
+        __m256i i = _mm256_cvtps_epi32(v);
+        return _mm_packs_epi32(_mm256_castsi256_si128(i), _mm256_extracti128_si256(i, 1));
+    }
+
+    PYBLADERF_AVX2 static inline void store_int(int16_t *p, vf v) { _mm_storeu_si128((__m128i *) p, pack_int(v)); }
+    PYBLADERF_AVX2 static inline void store_int(int8_t *p, vf v) { _mm_storel_epi64((__m128i *) p, _mm_packs_epi16(pack_int(v), pack_int(v))); }
+
+    PYBLADERF_AVX2 static inline vf load_power(const float *p) {
+        __m256 a = _mm256_loadu_ps(p);
+        __m256 b = _mm256_loadu_ps(p + 8);
+        a = _mm256_mul_ps(a, a);
+        b = _mm256_mul_ps(b, b);
+        __m256 s = _mm256_add_ps(_mm256_shuffle_ps(a, b, 0x88), _mm256_shuffle_ps(a, b, 0xDD));
+        return _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(s), 0xD8));
+    }
+};
+
+static inline int pybladerf_simd_has_avx2(void) {
+    static const int has_avx2 = [] {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2") ? 1 : 0;
+    }();
+    return has_avx2;
+}
+#endif
+
+#if defined(PYBLADERF_SIMD_SSE2)
+struct pybladerf_simd_sse2 {
+    typedef __m128 vf;
+    static const size_t width = 4;
+
+    static inline vf set1(float v) { return _mm_set1_ps(v); }
+    static inline vf set_pair(float a, float b) { return _mm_setr_ps(a, b, a, b); }
+    static inline vf load(const float *p) { return _mm_loadu_ps(p); }
+    static inline void store(float *p, vf v) { _mm_storeu_ps(p, v); }
+    static inline vf add(vf a, vf b) { return _mm_add_ps(a, b); }
+    static inline vf sub(vf a, vf b) { return _mm_sub_ps(a, b); }
+    static inline vf mul(vf a, vf b) { return _mm_mul_ps(a, b); }
+    static inline vf max(vf a, vf b) { return _mm_max_ps(a, b); }
+    static inline vf min(vf a, vf b) { return _mm_min_ps(a, b); }
+
+    static inline vf select_lt(vf a, vf b, vf x, vf y) {
+        __m128 m = _mm_cmplt_ps(a, b);
+        return _mm_or_ps(_mm_and_ps(m, x), _mm_andnot_ps(m, y));
+    }
+
+    static inline vf exponent(vf x) {
+        __m128i e = _mm_srli_epi32(_mm_castps_si128(x), 23);
+        return _mm_cvtepi32_ps(_mm_sub_epi32(e, _mm_set1_epi32(126)));
+    }
+
+    static inline vf mantissa(vf x) {
+        __m128i m = _mm_and_si128(_mm_castps_si128(x), _mm_set1_epi32(0x007FFFFF));
+        return _mm_castsi128_ps(_mm_or_si128(m, _mm_set1_epi32(0x3F000000)));
+    }
+
+    static inline vf load_int(const int16_t *p) {
+        __m128i v = _mm_loadl_epi64((const __m128i *) p);
+        return _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16));
+    }
+
+    static inline vf load_int(const int8_t *p) {
+        int32_t w;
+        memcpy(&w, p, sizeof(w));
+        __m128i v = _mm_cvtsi32_si128(w);
+        v = _mm_unpacklo_epi8(v, v);
+        return _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(v, v), 24));
+    }
+
+    static inline void store_int(int16_t *p, vf v) {
+        __m128i i = _mm_cvtps_epi32(v);
+        _mm_storel_epi64((__m128i *) p, _mm_packs_epi32(i, i));
+    }
+
+    static inline void store_int(int8_t *p, vf v) {
+        __m128i i = _mm_cvtps_epi32(v);
+        i = _mm_packs_epi32(i, i);
+        int32_t w = _mm_cvtsi128_si32(_mm_packs_epi16(i, i));
+        memcpy(p, &w, sizeof(w));
+    }
+
+    static inline vf load_power(const float *p) {
+        __m128 a = _mm_loadu_ps(p);
+        __m128 b = _mm_loadu_ps(p + 4);
+        a = _mm_mul_ps(a, a);
+        b = _mm_mul_ps(b, b);
+        return _mm_add_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)), _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+    }
+};
+typedef pybladerf_simd_sse2 pybladerf_simd_v;
+#define PYBLADERF_SIMD_NAME "sse2"
+
+#elif defined(PYBLADERF_SIMD_NEON)
+struct pybladerf_simd_neon {
+    typedef float32x4_t vf;
+    static const size_t width = 4;
+
+    static inline vf set1(float v) { return vdupq_n_f32(v); }
+
+    static inline vf set_pair(float a, float b) {
+        float pair[4] = {a, b, a, b};
+        return vld1q_f32(pair);
+    }
+
+    static inline vf load(const float *p) { return vld1q_f32(p); }
+    static inline void store(float *p, vf v) { vst1q_f32(p, v); }
+    static inline vf add(vf a, vf b) { return vaddq_f32(a, b); }
+    static inline vf sub(vf a, vf b) { return vsubq_f32(a, b); }
+    static inline vf mul(vf a, vf b) { return vmulq_f32(a, b); }
+    static inline vf max(vf a, vf b) { return vmaxq_f32(a, b); }
+    static inline vf min(vf a, vf b) { return vminq_f32(a, b); }
+    static inline vf select_lt(vf a, vf b, vf x, vf y) { return vbslq_f32(vcltq_f32(a, b), x, y); }
+
+    static inline vf exponent(vf x) {
+        int32x4_t e = vreinterpretq_s32_u32(vshrq_n_u32(vreinterpretq_u32_f32(x), 23));
+        return vcvtq_f32_s32(vsubq_s32(e, vdupq_n_s32(126)));
+    }
+
+    static inline vf mantissa(vf x) {
+        uint32x4_t m = vandq_u32(vreinterpretq_u32_f32(x), vdupq_n_u32(0x007FFFFF));
+        return vreinterpretq_f32_u32(vorrq_u32(m, vdupq_n_u32(0x3F000000)));
+    }
+
+    static inline vf load_int(const int16_t *p) { return vcvtq_f32_s32(vmovl_s16(vld1_s16(p))); }
+
+    static inline vf load_int(const int8_t *p) {
+        int32_t w;
+        memcpy(&w, p, sizeof(w));
+        int8x8_t v = vreinterpret_s8_s32(vdup_n_s32(w));
+        return vcvtq_f32_s32(vmovl_s16(vget_low_s16(vmovl_s8(v))));
+    }
+
+    static inline int16x4_t pack_int(vf v) {
+#if defined(__aarch64__)
+        return vqmovn_s32(vcvtnq_s32_f32(v));
+#else
+        uint32x4_t sign = vandq_u32(vreinterpretq_u32_f32(v), vdupq_n_u32(0x80000000));
+        vf half = vreinterpretq_f32_u32(vorrq_u32(sign, vreinterpretq_u32_f32(vdupq_n_f32(0.5f))));
+        return vqmovn_s32(vcvtq_s32_f32(vaddq_f32(v, half)));
+#endif
+    }
+
+    static inline void store_int(int16_t *p, vf v) { vst1_s16(p, pack_int(v)); }
+
+    static inline void store_int(int8_t *p, vf v) {
+        int16x4_t i = pack_int(v);
+        int32_t w = vget_lane_s32(vreinterpret_s32_s8(vqmovn_s16(vcombine_s16(i, i))), 0);
+        memcpy(p, &w, sizeof(w));
+    }
+
+    static inline vf load_power(const float *p) {
+        float32x4x2_t v = vld2q_f32(p);
+        return vmlaq_f32(vmulq_f32(v.val[0], v.val[0]), v.val[1], v.val[1]);
+    }
+};
+typedef pybladerf_simd_neon pybladerf_simd_v;
+#define PYBLADERF_SIMD_NAME "neon"
+
+#else
+#define PYBLADERF_SIMD_NAME "scalar"
+#endif
+
+static inline const char *pybladerf_simd_name(void) {
+#if defined(PYBLADERF_SIMD_AVX2)
+    if (pybladerf_simd_has_avx2())
+        return "avx2";
+#endif
+    return PYBLADERF_SIMD_NAME;
+}
+
+/*
+ * Natural logarithm (cephes logf), accurate to a few ulp for normal inputs.
+ * Inputs below FLT_MIN are clamped, so zero power maps to a finite floor.
+ */
+#define PYBLADERF_LOG_SQRTHF 0.707106781186547524f
+#define PYBLADERF_LOG_Q1 -2.12194440e-4f
+#define PYBLADERF_LOG_Q2 0.693359375f
+#define PYBLADERF_10_LOG10_E 4.342944819032518f
+
+static const float pybladerf_log_poly[9] = {
+    7.0376836292e-2f, -1.1514610310e-1f, 1.1676998740e-1f,
+    -1.2420140846e-1f, 1.4249322787e-1f, -1.6668057665e-1f,
+    2.0000714765e-1f, -2.4999993993e-1f, 3.3333331174e-1f,
+};
+
+static inline float pybladerf_log_scalar(float x) {
+    uint32_t bits;
+    float m, e, z, y;
+
+    if (x < FLT_MIN)
+        x = FLT_MIN;
+
+    memcpy(&bits, &x, sizeof(bits));
+    e = (float) ((int32_t) (bits >> 23) - 126);
+    bits = (bits & 0x007FFFFF) | 0x3F000000;
+    memcpy(&m, &bits, sizeof(m));
+
+    if (m < PYBLADERF_LOG_SQRTHF) {
+        e -= 1.0f;
+        m = m + m - 1.0f;
+    } else {
+        m = m - 1.0f;
+    }
+
+    z = m * m;
+    y = pybladerf_log_poly[0];
+    for (int i = 1; i < 9; i++)
+        y = y * m + pybladerf_log_poly[i];
+    y = y * m * z;
+    y += e * PYBLADERF_LOG_Q1;
+    y -= 0.5f * z;
+    return m + y + e * PYBLADERF_LOG_Q2;
+}
+
+#ifdef PYBLADERF_SIMD_VECTOR
+template <class V>
+static PYBLADERF_SIMD_INLINE void pybladerf_log_v(typename V::vf &x) {
+    typedef typename V::vf vf;
+    const vf one = V::set1(1.0f);
+
+    x = V::max(x, V::set1(FLT_MIN));
+    vf e = V::exponent(x);
+    vf m = V::mantissa(x);
+
+    vf sqrthf = V::set1(PYBLADERF_LOG_SQRTHF);
+    e = V::sub(e, V::select_lt(m, sqrthf, one, V::set1(0.0f)));
+    m = V::sub(V::select_lt(m, sqrthf, V::add(m, m), m), one);
+
+    vf z = V::mul(m, m);
+    vf y = V::set1(pybladerf_log_poly[0]);
+    for (int i = 1; i < 9; i++)
+        y = V::add(V::mul(y, m), V::set1(pybladerf_log_poly[i]));
+    y = V::mul(V::mul(y, m), z);
+    y = V::add(y, V::mul(e, V::set1(PYBLADERF_LOG_Q1)));
+    y = V::sub(y, V::mul(z, V::set1(0.5f)));
+    x = V::add(V::add(m, y), V::mul(e, V::set1(PYBLADERF_LOG_Q2)));
+}
+#endif
+
+/*
+ * Each kernel is a template over the back end V (used only in vector builds, the
+ * scalar loop finishes the tail) and a dispatcher that runs the AVX2 instance when
+ * the CPU has it and the build-time back end otherwise.
+ */
+#if defined(PYBLADERF_SIMD_AVX2)
+#define PYBLADERF_SIMD_DISPATCH(kernel, ...)                         \
+    do {                                                             \
+        if (pybladerf_simd_has_avx2())                               \
+            kernel##_avx2(__VA_ARGS__);                              \
+        else                                                         \
+            kernel##_v<pybladerf_simd_v>(__VA_ARGS__);               \
+    } while (0)
+#elif defined(PYBLADERF_SIMD_VECTOR)
+#define PYBLADERF_SIMD_DISPATCH(kernel, ...) kernel##_v<pybladerf_simd_v>(__VA_ARGS__)
+#else
+#define PYBLADERF_SIMD_DISPATCH(kernel, ...) kernel##_v<void>(__VA_ARGS__)
+#endif
+
+/*
+ * PSD pre-pass: converts n interleaved SC16_Q11/SC8_Q7 samples to complex float,
+ * removes the I/Q DC offset and applies the window. `window` holds 2 * n floats
+ * (each tap duplicated for I and Q) with the format scale already folded in.
+ */
+template <class V, typename T>
+static PYBLADERF_SIMD_INLINE void pybladerf_psd_prepare_v(const T *samples, const float *window, float *out, size_t n) {
+    int64_t sum_i = 0;
+    int64_t sum_q = 0;
+    size_t count = n * 2;
+    size_t i = 0;
+
+    for (i = 0; i < n; i++) {
+        sum_i += samples[2 * i];
+        sum_q += samples[2 * i + 1];
+    }
+
+    float mean_i = n ? (float) ((double) sum_i / (double) n) : 0.0f;
+    float mean_q = n ? (float) ((double) sum_q / (double) n) : 0.0f;
+
+    i = 0;
+#ifdef PYBLADERF_SIMD_VECTOR
+    typename V::vf mean = V::set_pair(mean_i, mean_q);
+    for (; i + V::width <= count; i += V::width)
+        V::store(out + i, V::mul(V::sub(V::load_int(samples + i), mean), V::load(window + i)));
+#endif
+    for (; i < count; i++)
+        out[i] = ((float) samples[i] - ((i & 1) ? mean_q : mean_i)) * window[i];
+}
+
+/*
+ * PSD post-pass: writes 10 * log10(|X|^2 * norm) of n complex bins to `out`.
+ */
+template <class V>
+static PYBLADERF_SIMD_INLINE void pybladerf_log_power_v(const float *spectrum, float *out, size_t n, float norm) {
+    size_t i = 0;
+#ifdef PYBLADERF_SIMD_VECTOR
+    typename V::vf scale = V::set1(norm);
+    typename V::vf db = V::set1(PYBLADERF_10_LOG10_E);
+    for (; i + V::width <= n; i += V::width) {
+        typename V::vf power = V::mul(V::load_power(spectrum + 2 * i), scale);
+        pybladerf_log_v<V>(power);
+        V::store(out + i, V::mul(power, db));
+    }
+#endif
+    for (; i < n; i++) {
+        float re = spectrum[2 * i];
+        float im = spectrum[2 * i + 1];
+        out[i] = pybladerf_log_scalar((re * re + im * im) * norm) * PYBLADERF_10_LOG10_E;
+    }
+}
+
+/*
+ * Same as pybladerf_log_power for the summed power of two spectra, |A|^2 + |B|^2.
+ */
+template <class V>
+static PYBLADERF_SIMD_INLINE void pybladerf_log_power_sum_v(const float *a, const float *b, float *out, size_t n, float norm) {
+    size_t i = 0;
+#ifdef PYBLADERF_SIMD_VECTOR
+    typename V::vf scale = V::set1(norm);
+    typename V::vf db = V::set1(PYBLADERF_10_LOG10_E);
+    for (; i + V::width <= n; i += V::width) {
+        typename V::vf power = V::mul(V::add(V::load_power(a + 2 * i), V::load_power(b + 2 * i)), scale);
+        pybladerf_log_v<V>(power);
+        V::store(out + i, V::mul(power, db));
+    }
+#endif
+    for (; i < n; i++) {
+        float power = a[2 * i] * a[2 * i] + a[2 * i + 1] * a[2 * i + 1] + b[2 * i] * b[2 * i] + b[2 * i + 1] * b[2 * i + 1];
+        out[i] = pybladerf_log_scalar(power * norm) * PYBLADERF_10_LOG10_E;
+    }
+}
+
+/*
+ * IQ format conversion. `count` is the number of scalar values (twice the number of
+ * complex samples). SC16_Q11/SC8_Q7 to float multiplies by `scale`; the reverse path
+ * scales, saturates to [lo, hi] and rounds to nearest.
+ */
+template <class V, typename T>
+static PYBLADERF_SIMD_INLINE void pybladerf_iq_to_float_v(const T *in, float *out, size_t count, float scale) {
+    size_t i = 0;
+#ifdef PYBLADERF_SIMD_VECTOR
+    typename V::vf s = V::set1(scale);
+    for (; i + V::width <= count; i += V::width)
+        V::store(out + i, V::mul(V::load_int(in + i), s));
+#endif
+    for (; i < count; i++)
+        out[i] = (float) in[i] * scale;
+}
+
+template <class V, typename T>
+static PYBLADERF_SIMD_INLINE void pybladerf_iq_from_float_v(const float *in, T *out, size_t count, float scale, float lo, float hi) {
+    size_t i = 0;
+#ifdef PYBLADERF_SIMD_VECTOR
+    typename V::vf s = V::set1(scale);
+    typename V::vf vlo = V::set1(lo);
+    typename V::vf vhi = V::set1(hi);
+    for (; i + V::width <= count; i += V::width)
+        V::store_int(out + i, V::min(V::max(V::mul(V::load(in + i), s), vlo), vhi));
+#endif
+    for (; i < count; i++) {
+        float v = in[i] * scale;
+        v = v < lo ? lo : (v > hi ? hi : v);
+        out[i] = (T) lrintf(v);
+    }
+}
+
+#if defined(PYBLADERF_SIMD_AVX2)
+template <typename T>
+PYBLADERF_AVX2 static void pybladerf_psd_prepare_avx2(const T *samples, const float *window, float *out, size_t n) {
+    pybladerf_psd_prepare_v<pybladerf_simd_avx2>(samples, window, out, n);
+}
+
+PYBLADERF_AVX2 static void pybladerf_log_power_avx2(const float *spectrum, float *out, size_t n, float norm) {
+    pybladerf_log_power_v<pybladerf_simd_avx2>(spectrum, out, n, norm);
+}
+
+PYBLADERF_AVX2 static void pybladerf_log_power_sum_avx2(const float *a, const float *b, float *out, size_t n, float norm) {
+    pybladerf_log_power_sum_v<pybladerf_simd_avx2>(a, b, out, n, norm);
+}
+
+template <typename T>
+PYBLADERF_AVX2 static void pybladerf_iq_to_float_avx2(const T *in, float *out, size_t count, float scale) {
+    pybladerf_iq_to_float_v<pybladerf_simd_avx2>(in, out, count, scale);
+}
+
+template <typename T>
+PYBLADERF_AVX2 static void pybladerf_iq_from_float_avx2(const float *in, T *out, size_t count, float scale, float lo, float hi) {
+    pybladerf_iq_from_float_v<pybladerf_simd_avx2>(in, out, count, scale, lo, hi);
+}
+#endif
+
+template <typename T>
+static inline void pybladerf_psd_prepare(const T *samples, const float *window, float *out, size_t n) {
+    PYBLADERF_SIMD_DISPATCH(pybladerf_psd_prepare, samples, window, out, n);
+}
+
+static inline void pybladerf_log_power(const float *spectrum, float *out, size_t n, float norm) {
+    PYBLADERF_SIMD_DISPATCH(pybladerf_log_power, spectrum, out, n, norm);
+}
+
+static inline void pybladerf_log_power_sum(const float *a, const float *b, float *out, size_t n, float norm) {
+    PYBLADERF_SIMD_DISPATCH(pybladerf_log_power_sum, a, b, out, n, norm);
+}
+
+template <typename T>
+static inline void pybladerf_iq_to_float(const T *in, float *out, size_t count, float scale) {
+    PYBLADERF_SIMD_DISPATCH(pybladerf_iq_to_float, in, out, count, scale);
+}
+
+template <typename T>
+static inline void pybladerf_iq_from_float(const float *in, T *out, size_t count, float scale, float lo, float hi) {
+    PYBLADERF_SIMD_DISPATCH(pybladerf_iq_from_float, in, out, count, scale, lo, hi);
+}
+
+/*
+ * Same as pybladerf_log_power, optionally reordering the bins like numpy.fft.fftshift.
+ */
+static inline void pybladerf_psd_power(const float *spectrum, float *out, size_t n, float norm, int shift) {
+    if (shift) {
+        size_t half = n / 2;
+        pybladerf_log_power(spectrum + 2 * (n - half), out, half, norm);
+        pybladerf_log_power(spectrum, out + half, n - half, norm);
+    } else {
+        pybladerf_log_power(spectrum, out, n, norm);
+    }
+}
+
+static inline void pybladerf_psd_power_sum(const float *a, const float *b, float *out, size_t n, float norm, int shift) {
+    if (shift) {
+        size_t half = n / 2;
+        pybladerf_log_power_sum(a + 2 * (n - half), b + 2 * (n - half), out, half, norm);
+        pybladerf_log_power_sum(a, b, out + half, n - half, norm);
+    } else {
+        pybladerf_log_power_sum(a, b, out, n, norm);
+    }
+}
+
+#if defined(PYBLADERF_SIMD_AVX2)
+#pragma GCC diagnostic pop
+#endif
+
+/*
+ * Splits n samples of a two channel (RX_X2) stream, I0 Q0 I1 Q1 ..., into one
+ * block of n interleaved I/Q samples per channel. Each I/Q pair is moved as one word.
+ */
+template <typename T>
+static inline void pybladerf_deinterleave_x2(const T *in, T *out0, T *out1, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        memcpy(out0 + 2 * i, in + 4 * i, 2 * sizeof(T));
+        memcpy(out1 + 2 * i, in + 4 * i + 2, 2 * sizeof(T));
+    }
+}
+
+/*
+ * Signal statistics of n interleaved SC16_Q11/SC8_Q7 samples, added to `acc`.
+ * A sample is clipped when |I| or |Q| reaches `clip_level`. With hist_shift >= 0
+ * max(|I|, |Q|) >> hist_shift is counted in the histogram (last bin saturates).
+ * The block loop keeps 32-bit partial sums so compilers can vectorize it, only
+ * the power sum is 64-bit since a full-scale SC16 sample squares to 2^31.
+ */
+#define PYBLADERF_IQ_HIST_BINS 64
+#define PYBLADERF_IQ_STATS_BLOCK 256
+
+struct pybladerf_iq_stats_acc {
+    uint64_t samples;
+    uint64_t power;
+    uint64_t peak;
+    uint64_t clipped;
+    int64_t sum_i;
+    int64_t sum_q;
+    uint64_t histogram[PYBLADERF_IQ_HIST_BINS];
+};
+
+static inline void pybladerf_iq_stats_clear(pybladerf_iq_stats_acc *acc) {
+    memset(acc, 0, sizeof(*acc));
+}
+
+static inline void pybladerf_iq_stats_merge(pybladerf_iq_stats_acc *dst, const pybladerf_iq_stats_acc *src) {
+    dst->samples += src->samples;
+    dst->power += src->power;
+    dst->peak = src->peak > dst->peak ? src->peak : dst->peak;
+    dst->clipped += src->clipped;
+    dst->sum_i += src->sum_i;
+    dst->sum_q += src->sum_q;
+    for (int b = 0; b < PYBLADERF_IQ_HIST_BINS; b++)
+        dst->histogram[b] += src->histogram[b];
+}
+
+template <typename T>
+static inline void pybladerf_iq_stats_update(const T *in, size_t n, int32_t clip_level, int hist_shift, pybladerf_iq_stats_acc *acc) {
+    uint32_t peak = (uint32_t) acc->peak;
+
+    for (size_t start = 0; start < n; start += PYBLADERF_IQ_STATS_BLOCK) {
+        size_t end = start + PYBLADERF_IQ_STATS_BLOCK < n ? start + PYBLADERF_IQ_STATS_BLOCK : n;
+        int32_t sum_i = 0;
+        int32_t sum_q = 0;
+        uint64_t power = 0;
+        uint32_t clipped = 0;
+
+        for (size_t k = start; k < end; k++) {
+            int32_t i = in[2 * k];
+            int32_t q = in[2 * k + 1];
+            uint32_t p = (uint32_t) (i * i) + (uint32_t) (q * q);
+            sum_i += i;
+            sum_q += q;
+            power += p;
+            peak = p > peak ? p : peak;
+            clipped += (uint32_t) ((i >= clip_level) | (i <= -clip_level) | (q >= clip_level) | (q <= -clip_level));
+        }
+
+        acc->sum_i += sum_i;
+        acc->sum_q += sum_q;
+        acc->power += power;
+        acc->clipped += clipped;
+    }
+
+    if (hist_shift >= 0) {
+        for (size_t k = 0; k < n; k++) {
+            int32_t i = in[2 * k] < 0 ? -in[2 * k] : in[2 * k];
+            int32_t q = in[2 * k + 1] < 0 ? -in[2 * k + 1] : in[2 * k + 1];
+            int32_t b = (i > q ? i : q) >> hist_shift;
+            acc->histogram[b < PYBLADERF_IQ_HIST_BINS ? b : PYBLADERF_IQ_HIST_BINS - 1]++;
+        }
+    }
+
+    acc->peak = peak;
+    acc->samples += n;
+}